@@ -0,0 +1,128 @@
+/******************************************************************************/
+/*!
+\file ecs_iteration.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Iterates 1M entities with a position and velocity through the ECS, and
+the same data as heap allocated objects iterated through pointers, the
+way games iterate Graphics::Shapes.
+Usage: ecs_iteration [entities]
+*/
+/******************************************************************************/
+#include "brewtools.h"
+#include <algorithm> // std::random_shuffle
+#include <chrono>    // std::chrono
+#include <cstdio>    // printf
+#include <cstdlib>   // atoi
+#include <thread>    // std::thread
+#include <vector>    // std::vector
+
+using namespace BrewTools;
+
+//! Position component
+struct Position { float x, y, z; };
+
+//! Velocity component
+struct Velocity { float x, y, z; };
+
+//! Heap allocated object, like a Graphics::Shape
+struct Object
+{
+  virtual ~Object() {}
+  Position position; //!< Position
+  Velocity velocity; //!< Velocity
+  float rotation; //!< Unused, makes the object shape-sized
+  float scale[3]; //!< Unused, makes the object shape-sized
+};
+
+//! Passes over the entities per measurement
+static const int PASSES = 20;
+
+/*****************************************/
+/*!
+\brief
+Times a function run PASSES times, and prints ns per entity.
+*/
+/*****************************************/
+template <typename F>
+static void Measure(const char *name, unsigned count, F func)
+{
+  func(); // Warm up
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < PASSES; ++i) func();
+  auto time = std::chrono::steady_clock::now() - start;
+  double ns = std::chrono::duration<double, std::nano>(time).count();
+  printf("%-28s %8.2f ms/pass %6.2f ns/entity\n", name, ns / PASSES / 1e6,
+    ns / PASSES / count);
+}
+
+int main(int argc, char **argv)
+{
+  unsigned count = (argc > 1) ? unsigned(atoi(argv[1])) : 1000000;
+  if (!count) count = 1;
+  Engine *engine = Engine::Get();
+  engine->SetHeadless(true);
+  engine->InitializeAll();
+  ECS *ecs = engine->GetSystem<ECS>();
+  for (unsigned i = 0; i < count; ++i)
+  {
+    Entity entity = ecs->Create();
+    ecs->Add<Position>(entity, Position{ float(i), 0, 0 });
+    ecs->Add<Velocity>(entity, Velocity{ 1, 2, 3 });
+  }
+
+  // Objects are allocated in order then shuffled, like shapes made and
+  // destroyed over a game
+  std::vector<Object *> objects(count);
+  for (unsigned i = 0; i < count; ++i)
+  {
+    objects[i] = new Object();
+    objects[i]->position = Position{ float(i), 0, 0 };
+    objects[i]->velocity = Velocity{ 1, 2, 3 };
+  }
+  std::random_shuffle(objects.begin(), objects.end());
+
+  printf("%u entities, %d passes\n", count, PASSES);
+  Measure("Objects through pointers", count, [&objects]() {
+    for (Object *object : objects)
+    {
+      object->position.x += object->velocity.x;
+      object->position.y += object->velocity.y;
+      object->position.z += object->velocity.z;
+    }
+  });
+  Measure("ECS::Each", count, [ecs]() {
+    ecs->Each<Position, Velocity>([](Entity, Position &p, Velocity &v) {
+      p.x += v.x;
+      p.y += v.y;
+      p.z += v.z;
+    });
+  });
+  auto chunk = [](unsigned n, Entity *, Position *p, Velocity *v) {
+    for (unsigned i = 0; i < n; ++i)
+    {
+      p[i].x += v[i].x;
+      p[i].y += v[i].y;
+      p[i].z += v[i].z;
+    }
+  };
+  Measure("ECS::ForEachChunk", count, [ecs, &chunk]() {
+    ecs->ForEachChunk<Position, Velocity>(chunk);
+  });
+  unsigned cores = std::thread::hardware_concurrency();
+  engine->SetWorkerCount(cores > 1 ? cores - 1 : 1);
+  printf("%u workers\n", engine->GetJobs().GetWorkerCount());
+  Measure("ECS::ParallelForEachChunk", count, [ecs, &chunk]() {
+    ecs->ParallelForEachChunk<Position, Velocity>(chunk);
+  });
+
+  for (Object *object : objects) delete object;
+  engine->Shutdown();
+  return 0;
+}
@@ -0,0 +1,91 @@
+/******************************************************************************/
+/*!
+\file job_scaling.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Measures how the job system scales from 1 to N cores: a compute bound
+ParallelFor, and many small jobs in a TaskGroup. The calling thread
+counts as a core, so N cores is N - 1 workers.
+Usage: job_scaling [max cores]
+*/
+/******************************************************************************/
+#include "brewtools.h"
+#include <atomic>  // std::atomic
+#include <chrono>  // std::chrono
+#include <cmath>   // std::sqrt
+#include <cstdio>  // printf
+#include <cstdlib> // atoi
+#include <thread>  // std::thread
+#include <vector>  // std::vector
+
+using namespace BrewTools;
+
+//! Passes of each measurement
+static const int PASSES = 10;
+
+/*****************************************/
+/*!
+\brief
+Times a function run PASSES times.
+
+\return
+Milliseconds per pass.
+*/
+/*****************************************/
+template <typename F>
+static double Measure(F func)
+{
+  func(); // Warm up
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < PASSES; ++i) func();
+  auto time = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::milli>(time).count() / PASSES;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned hardware = std::thread::hardware_concurrency();
+  unsigned cores = (argc > 1) ? unsigned(atoi(argv[1])) : hardware;
+  if (!cores) cores = 1;
+  Engine *engine = Engine::Get();
+  engine->SetHeadless(true);
+  engine->InitializeAll();
+  JobSystem &jobs = engine->GetJobs();
+
+  std::vector<double> values(1 << 22);
+  auto work = [&values, &jobs]() {
+    jobs.ParallelFor(0, unsigned(values.size()), 1 << 14,
+      [&values](unsigned begin, unsigned end) {
+        for (unsigned i = begin; i < end; ++i)
+          values[i] = std::sqrt(values[i] + i) * 1.0001;
+      });
+  };
+  std::atomic<unsigned> ran(0);
+  auto small = [&ran, &jobs]() {
+    TaskGroup group(&jobs);
+    for (int i = 0; i < 10000; ++i)
+      group.Run([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); });
+    group.Wait();
+  };
+
+  printf("%u hardware threads\n", hardware);
+  printf("cores  ParallelFor ms  speedup  10k jobs ms  jobs/s\n");
+  double base = 0;
+  for (unsigned n = 1; n <= cores; ++n)
+  {
+    engine->SetWorkerCount(n - 1);
+    double ms = Measure(work);
+    double jobms = Measure(small);
+    if (n == 1) base = ms;
+    printf("%5u  %14.2f  %7.2f  %11.2f  %6.0f\n", n, ms, base / ms, jobms,
+      10000 / (jobms / 1000));
+  }
+  engine->Shutdown();
+  return 0;
+}
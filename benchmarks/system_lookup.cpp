@@ -0,0 +1,87 @@
+/******************************************************************************/
+/*!
+\file system_lookup.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Compares looking up a system through the Engine's registry with the
+std::map lookup GetSystem used to do: a find, then operator[] again.
+Usage: system_lookup [lookups]
+*/
+/******************************************************************************/
+#include "brewtools.h"
+#include <chrono>  // std::chrono
+#include <cstdint> // uintptr_t
+#include <cstdio>  // printf
+#include <cstdlib> // atoi
+#include <map>     // std::map
+
+using namespace BrewTools;
+
+//! Lookups' results are added up here, so they aren't optimized out
+static volatile uintptr_t sink;
+
+/*****************************************/
+/*!
+\brief
+Times a lookup function and prints ns per lookup.
+*/
+/*****************************************/
+template <typename F>
+static void Measure(const char *name, unsigned lookups, F func)
+{
+  uintptr_t sum = 0;
+  for (unsigned i = 0; i < lookups / 10; ++i) sum += uintptr_t(func());
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < lookups; ++i) sum += uintptr_t(func());
+  auto time = std::chrono::steady_clock::now() - start;
+  sink = sum;
+  double ns = std::chrono::duration<double, std::nano>(time).count();
+  printf("%-40s %6.2f ns/lookup\n", name, ns / lookups);
+}
+
+int main(int argc, char **argv)
+{
+  unsigned lookups = (argc > 1) ? unsigned(atoi(argv[1])) : 50000000;
+  if (!lookups) lookups = 1;
+  Engine *engine = Engine::Get();
+  engine->SetHeadless(true);
+  engine->InitializeAll();
+  Engine *world = Engine::Create();
+  world->SetHeadless(true);
+  world->GetSystem<Trace>();
+
+  // The old registry, holding the same systems
+  std::map<SysID, ProtoSystem *> systems;
+  for (SysID id = 1; id <= ProtoSystem::GetSysIDCount(); ++id)
+  {
+    if (id < BT_MAX_SYSTEMS && engine->Find(id))
+      systems[id] = engine->Find(id);
+  }
+  std::map<SysID, ProtoSystem *> *registry = &systems;
+
+  printf("%u lookups, %u systems\n", lookups, unsigned(systems.size()));
+  Measure("std::map find + operator[]", lookups, [registry]() {
+    if (registry->size() && registry->find(Trace::id) != registry->end())
+      return (Trace *)((*registry)[Trace::id]);
+    return (Trace *)nullptr;
+  });
+  Measure("GetSystem<Trace>, default Engine", lookups, [engine]() {
+    return engine->GetSystem<Trace>();
+  });
+  Measure("GetSystemIfExists<Trace>, default Engine", lookups, [engine]() {
+    return engine->GetSystemIfExists<Trace>();
+  });
+  Measure("GetSystem<Trace>, created Engine", lookups, [world]() {
+    return world->GetSystem<Trace>();
+  });
+
+  world->Shutdown();
+  engine->Shutdown();
+  return 0;
+}
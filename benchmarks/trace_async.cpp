@@ -0,0 +1,99 @@
+/******************************************************************************/
+/*!
+\file trace_async.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Compares tracing to a file in sync and async mode, from several threads.
+Reports messages per second as seen by the callers and once everything
+is written, and how long each call took.
+Usage: trace_async [messages per thread]
+*/
+/******************************************************************************/
+#include "brewtools.h"
+#include <algorithm> // std::sort
+#include <cstdio>    // printf
+#include <cstdlib>   // atoi
+#include <thread>    // std::thread
+#include <vector>    // std::vector
+
+using namespace BrewTools;
+
+//! Threads tracing at once
+static const int THREADS = 4;
+
+/*****************************************/
+/*!
+\brief
+Traces from every thread and prints the results.
+
+\param trace
+Trace to use, already in the mode to measure.
+
+\param name
+Name of the mode.
+
+\param messages
+Messages each thread traces.
+*/
+/*****************************************/
+static void Run(Trace *trace, const char *name, int messages)
+{
+  std::vector<uint64_t> latency[THREADS];
+  std::vector<std::thread> threads;
+  uint64_t start = Time::Precise();
+  for (int i = 0; i < THREADS; ++i)
+  {
+    threads.emplace_back([trace, i, messages, &latency]() {
+      latency[i].reserve(messages);
+      for (int n = 0; n < messages; ++n)
+      {
+        uint64_t before = Time::Precise();
+        (*trace)[2] << "thread " << i << " traced message " << n <<
+          " of a moderately long log line";
+        latency[i].push_back(Time::Precise() - before);
+      }
+    });
+  }
+  for (auto &thread : threads) thread.join();
+  uint64_t returned = Time::Precise() - start;
+  trace->Flush();
+  uint64_t written = Time::Precise() - start;
+
+  std::vector<uint64_t> all;
+  for (auto &each : latency) all.insert(all.end(), each.begin(), each.end());
+  std::sort(all.begin(), all.end());
+  double total = double(THREADS) * messages;
+  printf("%-5s %12.0f msg/s returned %12.0f msg/s written   "
+    "p50 %4lluus  p99 %4lluus  max %6lluus\n", name,
+    total / (returned ? returned / 1e6 : 1e-6),
+    total / (written ? written / 1e6 : 1e-6),
+    (unsigned long long)all[all.size() / 2],
+    (unsigned long long)all[all.size() * 99 / 100],
+    (unsigned long long)all.back());
+}
+
+int main(int argc, char **argv)
+{
+  int messages = (argc > 1) ? atoi(argv[1]) : 100000;
+  if (messages <= 0) messages = 1;
+  Engine *engine = Engine::Get();
+  engine->SetHeadless(true);
+  engine->InitializeAll();
+  Trace *trace = engine->GetSystem<Trace>();
+  trace->OpenFile("trace_async.log");
+  printf("%d threads, %d messages each\n", THREADS, messages);
+  Run(trace, "sync", messages);
+  if (trace->SetAsync(true))
+  {
+    Run(trace, "async", messages);
+    trace->SetAsync(false);
+  }
+  engine->Shutdown();
+  return 0;
+}
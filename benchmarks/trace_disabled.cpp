@@ -0,0 +1,74 @@
+/******************************************************************************/
+/*!
+\file trace_disabled.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Measures what a message costs when its level is filtered out, traced
+the ways code used to trace through operator<<, and through BT_TRACE_TO.
+Usage: trace_disabled [messages]
+*/
+/******************************************************************************/
+#include "brewtools.h"
+#include <chrono>  // std::chrono
+#include <cstdio>  // printf
+#include <cstdlib> // atoi
+#include <sstream> // std::stringstream
+#include <string>  // std::string
+
+using namespace BrewTools;
+
+//! Value traced, volatile so it's read every time
+static volatile int value = 7;
+
+/*****************************************/
+/*!
+\brief
+Times a function and prints ns per message.
+*/
+/*****************************************/
+template <typename F>
+static void Measure(const char *name, unsigned messages, F func)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < messages; ++i) func();
+  auto time = std::chrono::steady_clock::now() - start;
+  double ns = std::chrono::duration<double, std::nano>(time).count();
+  printf("%-44s %7.2f ns/message\n", name, ns / messages);
+}
+
+int main(int argc, char **argv)
+{
+  unsigned messages = (argc > 1) ? unsigned(atoi(argv[1])) : 10000000;
+  if (!messages) messages = 1;
+  Engine *engine = Engine::Get();
+  engine->SetHeadless(true);
+  engine->InitializeAll();
+  Trace *trace = engine->GetSystem<Trace>();
+  // Every message below is traced at level 3, so they're all filtered
+  trace->SetMaxPrintLevel(2);
+
+  printf("%u filtered messages\n", messages);
+  Measure("operator<<, string formatted first", messages, [trace]() {
+    std::stringstream formatted;
+    formatted << value;
+    (*trace)[3] << "Drawing triangle " + formatted.str();
+  });
+  Measure("operator<<, chained", messages, [trace]() {
+    (*trace)[3] << "Drawing triangle " << value;
+  });
+  Measure("operator<<, literal only", messages, [trace]() {
+    (*trace)[3] << "Drawing triangle";
+  });
+  Measure("BT_TRACE_TO", messages, [trace]() {
+    BT_TRACE_TO(trace, 3, "Drawing triangle " << value);
+  });
+
+  engine->Shutdown();
+  return 0;
+}
@@ -17,9 +17,23 @@ Main BrewTools header that includes all other BrewTools Headers.
 #define __BT_BREWTOOLS_H_
 
 #include "brewtools/distillery.h" // Engine singleton class
+#include "brewtools/jobs.h" // JobSystem and TaskGroup classes
+#include "brewtools/arena.h" // FrameArena and ArenaAllocator classes
+#include "brewtools/profiler.h" // Profiler class
+#include "brewtools/zones.h" // BT_ZONE and Zones class
+#include "brewtools/events.h" // EventBus class
+#include "brewtools/memtrack.h" // MemTrack and AllocTag classes
+#include "brewtools/modules.h" // Modules and ModuleSystem classes
+#include "brewtools/coroutines.h" // Coroutine and Coroutines classes
+#include "brewtools/watchdog.h" // Watchdog class
+#include "brewtools/recorder.h" // Recorder class
+#include "brewtools/ecs.h" // ECS class
+#include "brewtools/ecsrenderer.h" // ECSRenderer class and components
 
 #include "brewtools/system.h" // System and ProtoSystem base classes
 #include "brewtools/trace.h" // Trace system class
+#include "brewtools/tracebinary.h" // Binary trace log layout
+#include "brewtools/traceline.h" // TraceLine class
 #include "brewtools/graphics.h" // Graphics system class
 
 #include "brewtools/window.h" // Window class
@@ -0,0 +1,261 @@
+/******************************************************************************/
+/*!
+\file arena.h
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Double-buffered per-frame linear allocator and STL allocator adapter.
+*/
+/******************************************************************************/
+
+#ifndef __BT_ARENA_H_
+#define __BT_ARENA_H_
+
+#include "brewtools/macros.h" // BT_NO_THREADS
+#include <cstddef> // size_t, std::max_align_t
+#include <vector>  // std::vector
+
+#ifndef BT_NO_THREADS
+#include <atomic> // std::atomic
+#include <mutex>  // std::mutex
+#endif
+
+#ifndef BT_FRAME_ARENA_SIZE
+//! Bytes in each of the frame arena's two buffers
+#define BT_FRAME_ARENA_SIZE 0x40000
+#endif
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  /*****************************************/
+  /*!
+  \brief
+  Linear allocator for transient data.
+  Allocating bumps an offset into the current buffer and nothing is ever
+  freed individually. Flip swaps to the other buffer and resets it, so
+  memory allocated during a frame stays valid until the end of the next.
+  Allocations that don't fit fall back to the heap and are counted.
+  Allocate may be called from any thread.
+  */
+  /*****************************************/
+  class FrameArena
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    Default constructor.
+
+    \param size
+    Bytes in each of the two buffers.
+    */
+    /*****************************************/
+    FrameArena(size_t size = BT_FRAME_ARENA_SIZE);
+
+    /*****************************************/
+    /*!
+    \brief
+    Destructor. Frees both buffers and any heap fallbacks.
+    */
+    /*****************************************/
+    ~FrameArena();
+
+    /*****************************************/
+    /*!
+    \brief
+    Allocates memory that lives until the end of the next frame.
+
+    \param size
+    Bytes to allocate.
+
+    \param align
+    Alignment of the allocation. Must be a power of 2.
+
+    \return
+    Pointer to the memory. Never nullptr.
+    */
+    /*****************************************/
+    void *Allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+    /*****************************************/
+    /*!
+    \brief
+    Allocates an uninitialized array that lives until the end of the
+    next frame.
+
+    \tparam T
+    Type of the elements.
+
+    \param count
+    Number of elements.
+
+    \return
+    Pointer to the first element.
+    */
+    /*****************************************/
+    template <typename T>
+    T *Allocate(size_t count)
+    {
+      return (T*)(Allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Ends the frame. Swaps to the other buffer and resets it.
+    Called by Engine::Update.
+    */
+    /*****************************************/
+    void Flip();
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the bytes used so far this frame.
+    */
+    /*****************************************/
+    size_t GetUsed() const { return offset; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the bytes in each buffer.
+    */
+    /*****************************************/
+    size_t GetCapacity() const { return size; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the most bytes used in a single frame.
+    */
+    /*****************************************/
+    size_t GetHighWater() const { return highwater; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the number of arena allocations that didn't fit and went to the
+    heap during the last completed frame. 0 for steady-state scenes that
+    fit in the arena. Only counts the arena's own fallbacks: the whole
+    frame's heap allocations are MemTrack::GetFrameAllocations.
+    */
+    /*****************************************/
+    unsigned GetOverflowAllocations() const { return lastheapallocs; }
+
+  private:
+    char *buffers[2]; //!< The two buffers
+    size_t size; //!< Bytes in each buffer
+    unsigned current; //!< Index of the buffer used this frame
+    std::vector<void *> overflow[2]; //!< Heap fallbacks for each buffer
+    size_t highwater; //!< Most bytes used in a single frame
+    unsigned lastheapallocs; //!< Heap fallbacks during the last frame
+    #ifndef BT_NO_THREADS
+    std::atomic<size_t> offset; //!< Bytes used in the current buffer
+    std::atomic<unsigned> heapallocs; //!< Heap fallbacks this frame
+    std::mutex overflowlock; //!< Guards overflow
+    #else
+    size_t offset; //!< Bytes used in the current buffer
+    unsigned heapallocs; //!< Heap fallbacks this frame
+    #endif
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  STL allocator that places containers in a FrameArena.
+  Deallocation does nothing. Containers must not outlive the frame after
+  the one they were filled in.
+
+  \tparam T
+  Type being allocated.
+  */
+  /*****************************************/
+  template <typename T>
+  class ArenaAllocator
+  {
+  public:
+    typedef T value_type; //!< Type being allocated
+
+    /*****************************************/
+    /*!
+    \brief
+    Conversion constructor.
+
+    \param arena
+    Arena to allocate from.
+    */
+    /*****************************************/
+    ArenaAllocator(FrameArena &arena) : arena(&arena) {}
+
+    /*****************************************/
+    /*!
+    \brief
+    Rebinding constructor.
+
+    \param other
+    Allocator for another type using the same arena.
+    */
+    /*****************************************/
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    /*****************************************/
+    /*!
+    \brief
+    Allocates uninitialized elements.
+
+    \param n
+    Number of elements.
+    */
+    /*****************************************/
+    T *allocate(size_t n) { return arena->Allocate<T>(n); }
+
+    /*****************************************/
+    /*!
+    \brief
+    Does nothing. The arena is reset wholesale.
+    */
+    /*****************************************/
+    void deallocate(T *, size_t) {}
+
+    FrameArena *arena; //!< Arena to allocate from
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Determines if two arena allocators share an arena.
+  */
+  /*****************************************/
+  template <typename T, typename U>
+  bool operator==(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs)
+  {
+    return lhs.arena == rhs.arena;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Determines if two arena allocators use different arenas.
+  */
+  /*****************************************/
+  template <typename T, typename U>
+  bool operator!=(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs)
+  {
+    return lhs.arena != rhs.arena;
+  }
+}
+
+#endif
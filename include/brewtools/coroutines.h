@@ -0,0 +1,372 @@
+/******************************************************************************/
+/*!
+\file coroutines.h
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Stackless coroutines resumed by the Engine each frame.
+*/
+/******************************************************************************/
+
+#ifndef __BT_COROUTINES_H_
+#define __BT_COROUTINES_H_
+
+#include "brewtools/macros.h" // BT_NO_THREADS
+#include <cstdint> // uint64_t, uint32_t
+#include <cstddef> // size_t
+#include <new>     // placement new
+#include <utility> // std::forward
+#include <vector>  // std::vector
+
+#ifndef BT_NO_THREADS
+#include <mutex> // std::mutex
+#endif
+
+#ifndef BT_COROUTINE_POOL_MAX
+//! Largest coroutine kept in the pool, bigger ones use the heap
+#define BT_COROUTINE_POOL_MAX 512
+#endif
+
+#ifndef BT_COROUTINE_SLAB
+#define BT_COROUTINE_SLAB 64 //!< Coroutines allocated by the pool at once
+#endif
+
+/*****************************************/
+/*!
+\brief
+Starts a coroutine's body. Must be the first statement of Resume.
+*/
+/*****************************************/
+#define BT_COROUTINE_BEGIN() switch (resumepoint) { case 0:
+
+/*****************************************/
+/*!
+\brief
+Ends a coroutine's body. Must be the last statement of Resume.
+*/
+/*****************************************/
+#define BT_COROUTINE_END() } resumepoint = 0; return true
+
+/*****************************************/
+/*!
+\brief
+Suspends the coroutine until a condition is met. Used by the BT_WAIT
+macros, which should be used instead.
+*/
+/*****************************************/
+#define BT_COROUTINE_SUSPEND(wait, value) \
+  do { \
+    Suspend(wait, value); \
+    resumepoint = __LINE__; \
+    return false; \
+    case __LINE__:; \
+  } while (0)
+
+//! Suspends the coroutine for a number of frames
+#define BT_WAIT_FRAMES(frames) \
+  BT_COROUTINE_SUSPEND(BrewTools::Coroutine::WAIT_FRAMES, frames)
+
+//! Suspends the coroutine until the next frame
+#define BT_YIELD() BT_WAIT_FRAMES(1)
+
+//! Suspends the coroutine for a number of ms of Time::Current
+#define BT_WAIT_MS(ms) \
+  BT_COROUTINE_SUSPEND(BrewTools::Coroutine::WAIT_TIME, ms)
+
+//! Suspends the coroutine until another coroutine finishes
+#define BT_WAIT_FOR(coroutine) \
+  BT_COROUTINE_SUSPEND(BrewTools::Coroutine::WAIT_COROUTINE, coroutine)
+
+//! Continues the coroutine as a job on the Engine's job system
+#define BT_RESUME_ON_WORKER() \
+  BT_COROUTINE_SUSPEND(BrewTools::Coroutine::WAIT_WORKER, 0)
+
+//! Continues the coroutine on the main thread during the next resume
+#define BT_RESUME_ON_MAIN() \
+  BT_COROUTINE_SUSPEND(BrewTools::Coroutine::WAIT_MAIN, 0)
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  class Engine; // Forward declaration
+
+  //! Handle of a coroutine, an index and a generation. 0 is never used
+  typedef uint32_t CoroutineID;
+
+  /*****************************************/
+  /*!
+  \brief
+  Base class for coroutines.
+  Resume holds the body between BT_COROUTINE_BEGIN and BT_COROUTINE_END,
+  and suspends with the BT_WAIT macros. The body is a switch, so locals
+  don't survive a suspension: keep state in members, and don't suspend
+  from inside another switch.
+  */
+  /*****************************************/
+  class Coroutine
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    What a suspended coroutine is waiting for.
+    */
+    /*****************************************/
+    enum Wait
+    {
+      WAIT_FRAMES,    //!< A number of frames to pass
+      WAIT_TIME,      //!< A number of ms to pass
+      WAIT_COROUTINE, //!< Another coroutine to finish
+      WAIT_WORKER,    //!< To be continued on a worker thread
+      WAIT_MAIN       //!< To be continued on the main thread
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Default constructor.
+    */
+    /*****************************************/
+    Coroutine()
+      : resumepoint(0), wait(WAIT_MAIN), until(0), size(0), id(0),
+        cancelled(false) {}
+
+    /*****************************************/
+    /*!
+    \brief
+    Destructor.
+    */
+    /*****************************************/
+    virtual ~Coroutine() {}
+
+    /*****************************************/
+    /*!
+    \brief
+    Runs the coroutine until it suspends or finishes.
+
+    \return
+    true if the coroutine finished.
+    */
+    /*****************************************/
+    virtual bool Resume() = 0;
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the coroutine's handle.
+    */
+    /*****************************************/
+    CoroutineID GetID() const { return id; }
+
+  protected:
+    /*****************************************/
+    /*!
+    \brief
+    Records what the coroutine waits for. Called by the BT_WAIT macros.
+
+    \param kind
+    What to wait for.
+
+    \param value
+    Frames, ms or CoroutineID depending on kind.
+    */
+    /*****************************************/
+    void Suspend(Wait kind, uint64_t value)
+    {
+      wait = kind;
+      until = value;
+    }
+
+    unsigned resumepoint; //!< Line to continue from, 0 to start
+
+  private:
+    friend class Coroutines;
+    Wait wait; //!< What the coroutine waits for
+    uint64_t until; //!< Frame, time or coroutine that ends the wait
+    size_t size; //!< Size of the coroutine for the pool
+    CoroutineID id; //!< Handle of the coroutine
+    bool cancelled; //!< Set by Coroutines::Cancel
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Runs coroutines. Engine::Update resumes the ones done waiting once per
+  frame, right before PHASE_UPDATE.
+  Coroutines come from a pool of fixed size blocks, so starting and
+  finishing them doesn't touch the heap once the pool has grown.
+  A coroutine on a worker thread runs until it suspends for anything
+  else, then goes back to the main thread.
+  */
+  /*****************************************/
+  class Coroutines
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    Conversion constructor.
+
+    \param engine
+    Engine whose job system runs coroutines on workers.
+    */
+    /*****************************************/
+    Coroutines(Engine *engine);
+
+    /*****************************************/
+    /*!
+    \brief
+    Destructor. Destroys unfinished coroutines and frees the pool.
+    */
+    /*****************************************/
+    ~Coroutines();
+
+    /*****************************************/
+    /*!
+    \brief
+    Starts a coroutine. It first runs during the next resume.
+    Safe on any thread.
+
+    \tparam T
+    Coroutine to start.
+
+    \param args
+    Arguments for T's constructor.
+
+    \return
+    Handle of the coroutine.
+    */
+    /*****************************************/
+    template <typename T, typename... Args>
+    CoroutineID Start(Args&&... args)
+    {
+      void *memory = Allocate(sizeof(T));
+      T *coroutine = new (memory) T(std::forward<Args>(args)...);
+      return Add(coroutine, sizeof(T));
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Stops a coroutine the next time it would be resumed.
+
+    \param id
+    Handle of the coroutine.
+    */
+    /*****************************************/
+    void Cancel(CoroutineID id);
+
+    /*****************************************/
+    /*!
+    \brief
+    Determines if a coroutine hasn't finished yet.
+
+    \param id
+    Handle of the coroutine.
+    */
+    /*****************************************/
+    bool Alive(CoroutineID id);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the number of unfinished coroutines.
+    */
+    /*****************************************/
+    unsigned GetCount() const { return living; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Resumes every coroutine that is done waiting.
+    Called by Engine::Update.
+    */
+    /*****************************************/
+    void Update();
+
+  private:
+    /*****************************************/
+    /*!
+    \brief
+    Slot of a coroutine handle.
+    */
+    /*****************************************/
+    struct Slot
+    {
+      Coroutine *coroutine; //!< The coroutine, nullptr if free
+      uint32_t generation; //!< Bumped each time the slot is freed
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets memory for a coroutine from the pool.
+
+    \param size
+    Size of the coroutine.
+    */
+    /*****************************************/
+    void *Allocate(size_t size);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gives a slot to a started coroutine and queues it.
+
+    \return
+    Handle of the coroutine.
+    */
+    /*****************************************/
+    CoroutineID Add(Coroutine *coroutine, size_t size);
+
+    /*****************************************/
+    /*!
+    \brief
+    Frees a coroutine's slot and returns its memory to the pool.
+    */
+    /*****************************************/
+    void Destroy(Coroutine *coroutine);
+
+    /*****************************************/
+    /*!
+    \brief
+    Determines if a coroutine is done waiting on the main thread.
+    */
+    /*****************************************/
+    bool Ready(Coroutine *coroutine);
+
+    /*****************************************/
+    /*!
+    \brief
+    Runs a coroutine on a worker until it suspends for anything else.
+    */
+    /*****************************************/
+    void RunOnWorker(Coroutine *coroutine);
+
+    Engine *engine; //!< Engine the coroutines run in
+    std::vector<Coroutine *> active; //!< Coroutines on the main thread
+    std::vector<Coroutine *> incoming; //!< Started or back from workers
+    std::vector<Slot> slots; //!< Handles by index
+    std::vector<uint32_t> freeslots; //!< Unused slot indices
+    //! Free blocks by size class, each a multiple of 64 bytes
+    std::vector<void *> freeblocks[BT_COROUTINE_POOL_MAX / 64];
+    std::vector<char *> slabs; //!< Memory owned by the pool
+    uint64_t frame; //!< Frames resumed so far
+    unsigned living; //!< Number of unfinished coroutines
+    #ifndef BT_NO_THREADS
+    std::mutex lock; //!< Guards incoming, the slots and the pool
+    #endif
+  };
+}
+
+#endif
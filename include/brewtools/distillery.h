@@ -16,7 +16,16 @@ Core of the engine. Holds pointers to all other major systems.
 #ifndef __BT_DISTILLERY_H_
 #define __BT_DISTILLERY_H_
 #include "brewtools/system.h"
-#include <map>
+#include "brewtools/jobs.h"
+#include "brewtools/arena.h"
+#include "brewtools/profiler.h"
+#include "brewtools/events.h"
+#include "brewtools/memtrack.h"
+#include "brewtools/modules.h"
+#include "brewtools/coroutines.h"
+#include "brewtools/watchdog.h"
+#include "brewtools/recorder.h"
+#include <vector>
 
 /*****************************************/
 /*!
@@ -26,25 +35,452 @@ Brewtools namespace.
 /*****************************************/
 namespace BrewTools
 {
+  /*****************************************/
+  /*!
+  \brief
+  Pointer to a system that other threads can read while it is set.
+  A system is fully created before it is stored, so readers never see it
+  half built.
+  */
+  /*****************************************/
+  class SystemSlot
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    Default constructor. The slot starts empty.
+    */
+    /*****************************************/
+    constexpr SystemSlot() : ptr(nullptr) {}
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the system, nullptr if the slot is empty.
+    */
+    /*****************************************/
+    operator ProtoSystem *() const
+    {
+      #ifndef BT_NO_THREADS
+      return ptr.load(std::memory_order_acquire);
+      #else
+      return ptr;
+      #endif
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Accesses the system.
+    */
+    /*****************************************/
+    ProtoSystem *operator->() const { return *this; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Stores a system.
+
+    \param system
+    The system, nullptr to empty the slot.
+    */
+    /*****************************************/
+    SystemSlot &operator=(ProtoSystem *system)
+    {
+      #ifndef BT_NO_THREADS
+      ptr.store(system, std::memory_order_release);
+      #else
+      ptr = system;
+      #endif
+      return *this;
+    }
+
+  private:
+    SystemSlot(const SystemSlot &) = delete;
+    SystemSlot &operator=(const SystemSlot &) = delete;
+    #ifndef BT_NO_THREADS
+    std::atomic<ProtoSystem *> ptr; //!< The system, nullptr if empty
+    #else
+    ProtoSystem *ptr; //!< The system, nullptr if empty
+    #endif
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Per-type cache of a system pointer.
+  Lets GetSystem resolve with a single load instead of indexing the registry.
+  Only the default Engine uses it, other Engines index their registry.
+
+  \tparam T
+  System being cached.
+  */
+  /*****************************************/
+  template <typename T>
+  struct SystemCache
+  {
+    static SystemSlot ptr; //!< Pointer to the live T, nullptr if none
+  };
+
+  template <typename T>
+  SystemSlot SystemCache<T>::ptr;
+
   /*****************************************/
   /*!
   \brief
   Engine singleton class.
   The Engine class holds a pointer to all major systems. 
+  Engine::Create makes more Engines (worlds) with their own systems, so
+  several simulations can run in one process, each updated on its own
+  thread. Get returns the Engine whose code is running on the thread.
   */
   /*****************************************/
   class Engine
   {
+    friend class Modules; // Swaps reloaded systems into the registry
   private:
-    std::map<SysID, ProtoSystem*> systems; //!< Map of IDs to system pointers
+    SystemSlot systems[BT_MAX_SYSTEMS]; //!< Systems indexed by SysID
+    SystemSlot *caches[BT_MAX_SYSTEMS]; //!< Per-type caches by SysID
+    //! Set by the thread creating each system
+    #ifndef BT_NO_THREADS
+    std::atomic<bool> claimed[BT_MAX_SYSTEMS];
+    //! Thread creating each system, so a constructor asking for its own
+    //! system fails instead of waiting on itself
+    std::atomic<std::thread::id> builders[BT_MAX_SYSTEMS];
+    #else
+    bool claimed[BT_MAX_SYSTEMS];
+    #endif
+    SysID highest; //!< Highest SysID currently held
+    bool primary; //!< Determines if this is the default Engine
+    unsigned raceviolations; //!< Undeclared accesses seen in race check mode
+    JobSystem jobs; //!< Job system shared by the engine and game code
+    FrameArena arena; //!< Transient memory reset at the end of each Update
+    EventBus events; //!< Events dispatched between update phases
+    Modules modules; //!< Systems loaded from shared objects
+    Coroutines coroutines; //!< Coroutines resumed before PHASE_UPDATE
+    Watchdog watchdog; //!< Writes reports of frames over budget
+    Recorder recorder; //!< Records and replays external inputs
+    uint64_t fixedstep; //!< Fixed simulation step in us, 0 if disabled
+    unsigned maxfixedsteps; //!< Max fixed steps run in one Update
+    uint64_t accumulator; //!< Time not yet simulated in us
+    uint64_t lastframe; //!< Time of the last Update in us
+    float alpha; //!< Fraction of a step left in the accumulator
+    bool fixedpass; //!< Determines if FixedUpdate is being dispatched
+    //! Systems in each phase, sorted by priority then SysID
+    std::vector<SysID> phases[ProtoSystem::PHASE_COUNT];
+    uint64_t phasemasks[ProtoSystem::PHASE_COUNT]; //!< Bit per SysID in phases
+    std::vector<SysID> active; //!< Systems of a phase updating this frame
+    /*****************************************/
+    /*!
+    \brief
+    Update policy of a system not updating every frame, copied out so
+    idle systems aren't touched.
+    */
+    /*****************************************/
+    struct Throttle
+    {
+      SysID id; //!< ID of the system
+      ProtoSystem::UpdatePolicy policy; //!< How often it updates
+      unsigned value; //!< N of the policy
+    };
+    std::vector<Throttle> throttled; //!< Systems not updating every frame
+    uint64_t nextupdate[BT_MAX_SYSTEMS]; //!< Due time of UPDATE_FREQUENCY in us
+    uint64_t framecount; //!< Frames updated so far
+    uint64_t always; //!< Bit per SysID of UPDATE_ALWAYS systems
+    uint64_t due; //!< Bit per SysID whose policy updates it this frame
+    uint64_t awake; //!< Bit per SysID woken but not updated yet
+    uint64_t served; //!< Bit per SysID woken and updated this frame
+    uint64_t rewoken; //!< Bit per SysID woken again after updating
+    #ifndef BT_NO_THREADS
+    std::atomic<uint64_t> woken; //!< Bit per SysID woken since last checked
+    #else
+    uint64_t woken; //!< Bit per SysID woken since last checked
+    #endif
+    unsigned phaseversion; //!< ProtoSystem phase version phases was built at
+    #ifndef BT_NO_THREADS
+    std::atomic<bool> phasesdirty; //!< Set when systems are added
+    #else
+    bool phasesdirty; //!< Set when systems are added
+    #endif
+    ProtoSystem::Phase currentphase; //!< Phase being dispatched
+    Profiler profiler; //!< Timings of each system and frame
+    uint64_t updated; //!< Bit per SysID of systems updated this frame
+    unsigned profiledump; //!< Frames between profile dumps, 0 for none
+    unsigned profilelevel; //!< Trace level profile dumps are written at
+    unsigned profileframes; //!< Frames since the last profile dump
+    bool headless; //!< Determines if Graphics runs without a GPU or window
+    //! Creates a system
+    typedef ProtoSystem *(*Factory)();
+    /*****************************************/
+    /*!
+    \brief
+    How to create a registered system.
+    */
+    /*****************************************/
+    struct Registration
+    {
+      Factory factory; //!< Creates the system, nullptr if not registered
+      SystemSlot *cache; //!< Per-type cache of the system
+      uint64_t deps; //!< Bit per SysID that must be created first
+      unsigned flags; //!< InitFlags
+    };
+    Registration registrations[BT_MAX_SYSTEMS]; //!< Registered systems
+    uint64_t inittimes[BT_MAX_SYSTEMS]; //!< Creation time of each system
+    uint64_t startuptime; //!< Time InitializeAll took in us
+    #ifndef BT_NO_THREADS
+    std::atomic<unsigned> pending[BT_MAX_SYSTEMS]; //!< Unfinished dependencies
+    uint64_t dependents[BT_MAX_SYSTEMS]; //!< Systems waiting on each system
+    std::atomic<unsigned> remaining; //!< Systems not yet updated this frame
+    std::mutex mainmutex; //!< Guards mainready
+    SysID mainready[BT_MAX_SYSTEMS]; //!< Ready systems for the main thread
+    unsigned mainhead, maintail; //!< Range of mainready still to be taken
+    std::mutex racemutex; //!< Guards raceviolations
+    std::mutex addmutex; //!< Guards the registry while systems init
+    #endif
+    
+    /*****************************************/
+    /*!
+    \brief
+    Stores a newly created system in the registry.
+
+    \param id
+    ID of the system.
+
+    \param system
+    Pointer to the system.
+
+    \param cache
+    Per-type cache to fill with the system, nullptr if it has none.
+
+    \param start
+    Clock time the system started being created, for the startup report.
+
+    \return
+    true if the system was stored, false if the id is out of range.
+    */
+    /*****************************************/
+    bool AddSystem(
+      SysID id, ProtoSystem *system, SystemSlot *cache, uint64_t start
+    );
+
+    /*****************************************/
+    /*!
+    \brief
+    Stores how to create a system.
+
+    \param id
+    ID of the system.
+
+    \param factory
+    Function creating the system.
+
+    \param cache
+    Per-type cache of the system.
+
+    \param deps
+    Bit per SysID that must be created first.
+
+    \param flags
+    InitFlags.
+    */
+    /*****************************************/
+    void RegisterFactory(
+      SysID id, Factory factory, SystemSlot *cache, uint64_t deps,
+      unsigned flags
+    );
+
+    /*****************************************/
+    /*!
+    \brief
+    Claims the creation of a system, so only one thread creates it.
+
+    \param id
+    ID of the system.
+
+    \return
+    true if the calling thread should create the system, false if another
+    thread already is.
+    */
+    /*****************************************/
+    bool Claim(SysID id);
+
+    /*****************************************/
+    /*!
+    \brief
+    Ends a claim once the system is stored, or gives it back if the
+    system couldn't be created.
+
+    \param id
+    ID of the system.
+
+    \param created
+    true if the system was stored.
+    */
+    /*****************************************/
+    void Release(SysID id, bool created);
+
+    /*****************************************/
+    /*!
+    \brief
+    Waits for another thread to finish creating a system, running jobs in
+    the meantime. Fails if the calling thread is the one creating it,
+    which means a constructor asked for its own system.
+
+    \param id
+    ID of the system.
+
+    \return
+    Pointer to the system, nullptr if it asked for itself or couldn't be
+    created.
+    */
+    /*****************************************/
+    ProtoSystem *Await(SysID id);
+
+    /*****************************************/
+    /*!
+    \brief
+    Creates a registered system and stores it.
+
+    \param id
+    ID of the system.
+    */
+    /*****************************************/
+    void InitSystem(SysID id);
+
+    /*****************************************/
+    /*!
+    \brief
+    Creates a system of type T.
+    */
+    /*****************************************/
+    template <typename T>
+    static ProtoSystem *CreateSystem() { return new T; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the clock used to time system creation, in us.
+    */
+    /*****************************************/
+    static uint64_t Clock();
+
+    /*****************************************/
+    /*!
+    \brief
+    Updates (or fixed updates) a single system, tracking it for race
+    checking.
+
+    \param id
+    ID of the system to update.
+    */
+    /*****************************************/
+    void RunSystem(SysID id);
+
+    /*****************************************/
+    /*!
+    \brief
+    Rebuilds the per-phase lists of systems, sorted by priority then SysID.
+    */
+    /*****************************************/
+    void SortPhases();
+
+    /*****************************************/
+    /*!
+    \brief
+    Finds the systems whose update policy updates them this frame.
+    */
+    /*****************************************/
+    void ScheduleFrame();
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the systems of a phase that update this frame, leaving out idle
+    ones without touching them.
+
+    \param phase
+    Phase being dispatched.
+
+    \return
+    Systems to update, in update order.
+    */
+    /*****************************************/
+    const std::vector<SysID> &GetActive(unsigned phase);
+
+    /*****************************************/
+    /*!
+    \brief
+    Updates every system in a phase once, in parallel if there are workers.
+    Calls FixedUpdate instead during the fixed pass.
+
+    \param list
+    Systems in the phase, in update order.
+    */
+    /*****************************************/
+    void RunPass(const std::vector<SysID> &list);
+
+    #ifndef BT_NO_THREADS
+    /*****************************************/
+    /*!
+    \brief
+    Builds the phase's dependency graph and updates its systems with the
+    job system.
+
+    \param list
+    Systems in the phase, in update order.
+    */
+    /*****************************************/
+    void RunParallel(const std::vector<SysID> &list);
+
+    /*****************************************/
+    /*!
+    \brief
+    Hands a system whose dependencies are done to a thread that can
+    update it.
+
+    \param id
+    ID of the ready system.
+    */
+    /*****************************************/
+    void Dispatch(SysID id);
+
+    /*****************************************/
+    /*!
+    \brief
+    Marks a system as updated and dispatches the systems waiting on it.
+
+    \param id
+    ID of the finished system.
+    */
+    /*****************************************/
+    void FinishSystem(SysID id);
+    #endif
     
     /*****************************************/
     /*!
     \brief
-    Default constructor. Called by Get.
+    Makes an Engine the current one of the calling thread.
+
+    \param engine
+    The new current Engine, nullptr for the default one.
+
+    \return
+    The previous current Engine.
     */
     /*****************************************/
-    Engine();
+    static Engine *Swap(Engine *engine);
+
+    /*****************************************/
+    /*!
+    \brief
+    Conversion constructor. Called by Get and Create.
+
+    \param primary
+    true for the default Engine.
+    */
+    /*****************************************/
+    Engine(bool primary);
     /*****************************************/
     /*!
     \brief
@@ -54,24 +490,150 @@ namespace BrewTools
     ~Engine();
     
   public:
+    /*****************************************/
+    /*!
+    \brief
+    Makes an Engine current on the calling thread while in scope. The
+    Engine does this itself while it updates or creates systems; game code
+    only needs it on its own threads or jobs that use another Engine.
+    */
+    /*****************************************/
+    class Scope
+    {
+    public:
+      /*****************************************/
+      /*!
+      \brief
+      Conversion constructor.
+
+      \param engine
+      Engine to make current.
+      */
+      /*****************************************/
+      Scope(Engine *engine) : previous(Engine::Swap(engine)) {}
+
+      /*****************************************/
+      /*!
+      \brief
+      Destructor. Restores the previous current Engine.
+      */
+      /*****************************************/
+      ~Scope() { Engine::Swap(previous); }
+
+    private:
+      Engine *previous; //!< Current Engine before the scope
+    };
+
     /*****************************************/
     /*!
     \brief
     Used for obtaining the Engine singleton pointer.
+    Returns the current Engine of the calling thread, which is the default
+    one unless another Engine is updating or creating systems on it.
     
     \return
     Engine singleton pointer if successful, nullptr otherwise.
     */
     /*****************************************/
     static Engine *Get();
+
+    /*****************************************/
+    /*!
+    \brief
+    Creates an Engine separate from the default one, with its own systems,
+    events, jobs and profiler. Different Engines can be updated at the
+    same time from different threads, but one Engine must only be updated
+    from one thread at a time. Extra Engines are meant for simulations and
+    should usually be headless. Destroy them with Shutdown.
+
+    \return
+    The new Engine.
+    */
+    /*****************************************/
+    static Engine *Create();
+
+    /*****************************************/
+    /*!
+    \brief
+    Determines if this is the default Engine.
+    */
+    /*****************************************/
+    bool IsDefault() const { return primary; }
     
     /*****************************************/
     /*!
     \brief
-    Initializes all systems.
+    Flags for Register.
+    */
+    /*****************************************/
+    enum InitFlags
+    {
+      INIT_MAIN_THREAD = 1, //!< Must be created on the calling thread
+      INIT_LAZY = 2 //!< Left for the first GetSystem instead of InitializeAll
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Registers a system to be created by InitializeAll.
+    Trace, Time and Graphics are registered by default.
+
+    \tparam T
+    System to register.
+
+    \tparam Deps
+    Systems T's constructor uses, which are created before it.
+
+    \param flags
+    InitFlags.
+    */
+    /*****************************************/
+    template <typename T, typename... Deps>
+    void Register(unsigned flags = 0)
+    {
+      // The trailing 0 keeps the array valid when Deps is empty
+      SysID ids[] = { Deps::id..., 0 };
+      uint64_t deps = 0;
+      for (unsigned i = 0; i < sizeof...(Deps); ++i)
+        if (ids[i] < BT_MAX_SYSTEMS) deps |= uint64_t(1) << ids[i];
+      RegisterFactory(
+        T::id, &CreateSystem<T>, &SystemCache<T>::ptr, deps, flags
+      );
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Creates every registered system that isn't lazy.
+    Systems whose dependencies are met are created together, in parallel
+    on the job system unless they need the main thread. A startup report
+    with each system's creation time is written to Trace at level 1.
+    Constructors must only use systems they declared as dependencies.
     */
     /*****************************************/
     void InitializeAll();
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets how long a system took to create, in us.
+
+    \param id
+    ID of the system.
+    */
+    /*****************************************/
+    uint64_t GetInitTime(SysID id) const
+    {
+      return (id < BT_MAX_SYSTEMS) ? inittimes[id] : 0;
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets how long InitializeAll took, in us.
+    */
+    /*****************************************/
+    uint64_t GetStartupTime() const { return startuptime; }
     
     /*****************************************/
     /*!
@@ -85,15 +647,322 @@ namespace BrewTools
     /*!
     \brief
     Updates all living systems.
+    Each phase is dispatched in order, updating the systems in it by
+    priority, then delivering queued events. Coroutines are resumed
+    right before PHASE_UPDATE. See ProtoSystem::SetPhase.
+
+    \return
+    false once a replay has run out of recorded frames, true otherwise.
     */
     /*****************************************/
     bool Update();
+
+    /*****************************************/
+    /*!
+    \brief
+    Sets the fixed simulation step.
+    Each Update then accumulates the time since the last one and calls
+    FixedUpdate on every PHASE_UPDATE system once per whole step, right
+    before that phase, so simulation cost stays stable while the render
+    rate varies. Systems in other phases never get FixedUpdate.
+
+    \param step
+    Length of a step in microseconds. 0 disables fixed stepping.
+
+    \param maxsteps
+    Max steps per Update. Time beyond this is dropped so a slow frame
+    can't cause ever slower frames.
+    */
+    /*****************************************/
+    void SetFixedStep(uint64_t step, unsigned maxsteps = 5);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the fixed simulation step.
+
+    \return
+    Length of a step in microseconds, 0 if fixed stepping is disabled.
+    */
+    /*****************************************/
+    uint64_t GetFixedStep() const { return fixedstep; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the fixed simulation step for use in FixedUpdate.
+
+    \return
+    Length of a step in seconds.
+    */
+    /*****************************************/
+    float GetFixedDT() const { return fixedstep / 1000000.0f; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets how far between the last and next fixed step the current frame
+    is. Renderers should interpolate between simulation states with it.
+
+    \return
+    Interpolation alpha in [0, 1).
+    */
+    /*****************************************/
+    float GetAlpha() const { return alpha; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Makes a system update in its next phase, whatever its update policy.
+    Wakes from event subscribers after a phase reach later phases of the
+    same frame. Safe on any thread.
+
+    \param id
+    ID of the system to wake.
+    */
+    /*****************************************/
+    void Wake(SysID id);
+
+    /*****************************************/
+    /*!
+    \brief
+    Makes a system update in its next phase, whatever its update policy.
+
+    \tparam T
+    System to wake.
+    */
+    /*****************************************/
+    template <typename T>
+    void Wake() { Wake(T::id); }
+
+    /*****************************************/
+    /*!
+    \brief
+    Wakes a system whenever an event is dispatched. Pairs with
+    UPDATE_ON_WAKE for systems that only react to events.
+
+    \tparam E
+    Type of the event.
+
+    \tparam T
+    System to wake.
+
+    \return
+    Handle for EventBus::Unsubscribe, 0 if there are too many event types.
+    */
+    /*****************************************/
+    template <typename E, typename T>
+    unsigned WakeOn()
+    {
+      SysID id = T::id;
+      return events.Subscribe<E>([this, id](const E *, unsigned) {
+        Wake(id);
+      });
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Sets the number of worker threads used to update systems.
+    Systems that declared their accesses and don't conflict with each other
+    are updated concurrently. Results match the serial SysID order.
+    0 workers (the default) updates every system on the calling thread.
+
+    \param count
+    Number of worker threads in addition to the calling thread.
+    */
+    /*****************************************/
+    void SetWorkerCount(unsigned count);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the number of worker threads used to update systems.
+    */
+    /*****************************************/
+    unsigned GetWorkerCount() const;
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the Engine's job system.
+    Game code and systems should push fine-grained work here instead of
+    starting their own threads.
+
+    \return
+    Reference to the job system.
+    */
+    /*****************************************/
+    JobSystem &GetJobs() { return jobs; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the Engine's frame arena.
+    Memory allocated from it stays valid until the end of the next Update.
+    Use ArenaAllocator to put transient containers in it.
+
+    \return
+    Reference to the frame arena.
+    */
+    /*****************************************/
+    FrameArena &GetFrameArena() { return arena; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Sets headless mode. Must be called before Graphics is created.
+    A headless Graphics creates no window or GPU context, and Shape::Draw
+    only counts the work (see Graphics::GetDrawCount). For servers and
+    benchmarks on machines without a GPU.
+
+    \param enable
+    true to run headless.
+    */
+    /*****************************************/
+    void SetHeadless(bool enable) { headless = enable; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Determines if the engine is running headless.
+    */
+    /*****************************************/
+    bool IsHeadless() const { return headless; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the event bus. Queued events are delivered after every phase.
+
+    \return
+    Reference to the event bus.
+    */
+    /*****************************************/
+    EventBus &GetEvents() { return events; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the modules loaded from shared objects. Changed modules are
+    reloaded at the start of Update.
+
+    \return
+    Reference to the modules.
+    */
+    /*****************************************/
+    Modules &GetModules() { return modules; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the Engine's coroutines. Those done waiting are resumed once per
+    Update, right before PHASE_UPDATE.
+
+    \return
+    Reference to the coroutines.
+    */
+    /*****************************************/
+    Coroutines &GetCoroutines() { return coroutines; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the per-system frame profiler.
+    Profiling is on by default and can be turned off with
+    GetProfile().SetEnabled(false).
+
+    \return
+    Reference to the profiler.
+    */
+    /*****************************************/
+    Profiler &GetProfile() { return profiler; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the frame budget watchdog. Set a budget with
+    GetWatchdog().SetBudget to have frames over it write hitch reports.
+
+    \return
+    Reference to the watchdog.
+    */
+    /*****************************************/
+    Watchdog &GetWatchdog() { return watchdog; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the input recorder. Inputs from outside the engine should be sent
+    through GetRecorder().Input so sessions can be recorded and replayed.
+
+    \return
+    Reference to the recorder.
+    */
+    /*****************************************/
+    Recorder &GetRecorder() { return recorder; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Periodically writes the profiler's statistics through Trace, along
+    with per-system allocations when BT_TRACK_ALLOCATIONS is defined.
+
+    \param frames
+    Frames between dumps. 0 stops dumping.
+
+    \param level
+    Trace level to write at.
+    */
+    /*****************************************/
+    void SetProfileDump(unsigned frames, unsigned level = 1);
+
+    /*****************************************/
+    /*!
+    \brief
+    Checks that the currently updating system declared access to a system.
+    Called by GetSystem and GetSystemIfExists when BT_RACE_CHECK is defined.
+
+    \param id
+    ID of the system being accessed.
+    */
+    /*****************************************/
+    void CheckAccess(SysID id);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the number of undeclared system accesses caught by race checking.
+    */
+    /*****************************************/
+    unsigned GetRaceViolations() const { return raceviolations; }
     
+    /*****************************************/
+    /*!
+    \brief
+    Gets a system from the registry.
+
+    \param id
+    ID of the system.
+
+    \return
+    Pointer to the system if it exists, nullptr otherwise.
+    */
+    /*****************************************/
+    ProtoSystem *Find(SysID id) const
+    {
+      if (id >= BT_MAX_SYSTEMS) return nullptr;
+      return systems[id];
+    }
+
     /*****************************************/
     /*!
     \brief
     Gets a system from the engine.
     If the system has not yet been created, it will be created.
+    Safe on any thread: existing systems are a single load, and a system
+    is only ever created once, other callers waiting for it. A system's
+    constructor can't get the system itself: that returns nullptr.
 
     \tparam T
     System to get.
@@ -105,10 +974,30 @@ namespace BrewTools
     template <typename T>
     T* GetSystem()
     {
-      if (systems.size() && systems.find(T::id) != systems.end())
-        return (T*)(systems[T::id]);
-      systems[T::id] = new T;
-      return (T*)(systems[T::id]);
+      #ifdef BT_RACE_CHECK
+      CheckAccess(T::id);
+      #endif
+      ProtoSystem *existing = primary ? SystemCache<T>::ptr : Find(T::id);
+      if (existing)
+        return (T*)(existing);
+      if (!Claim(T::id))
+        return (T*)(Await(T::id));
+      uint64_t start = Clock();
+      T *system;
+      {
+        Scope scope(this);
+        AllocTag tag(T::id);
+        system = new T;
+      }
+      SystemSlot *cache = primary ? &SystemCache<T>::ptr : nullptr;
+      if (!AddSystem(T::id, system, cache, start))
+      {
+        Release(T::id, false);
+        delete system;
+        return nullptr;
+      }
+      Release(T::id, true);
+      return system;
     }
     
     /*****************************************/
@@ -126,9 +1015,10 @@ namespace BrewTools
     template <typename T>
     T* GetSystemIfExists()
     {
-      if (systems.size() && systems.find(T::id) != systems.end())
-        return (T*)(systems[T::id]);
-      return nullptr;
+      #ifdef BT_RACE_CHECK
+      CheckAccess(T::id);
+      #endif
+      return (T*)(primary ? SystemCache<T>::ptr : Find(T::id));
     }
   };
 }
@@ -0,0 +1,571 @@
+/******************************************************************************/
+/*!
+\file ecs.h
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Archetype based entity component system.
+*/
+/******************************************************************************/
+
+#ifndef __BT_ECS_H_
+#define __BT_ECS_H_
+
+#include "brewtools/system.h"     // System base class
+#include "brewtools/distillery.h" // Engine class
+#include <cstdint> // uint32_t, uint64_t
+#include <cstring> // memcpy
+#include <type_traits> // std::is_trivially_copyable
+#include <vector>  // std::vector
+#include <map>     // std::map
+
+#ifndef BT_MAX_COMPONENTS
+#define BT_MAX_COMPONENTS 64 //!< Max component types, one bit each in a mask
+#endif
+
+#ifndef BT_ECS_CHUNK_SIZE
+//! Bytes in each chunk of entities
+#define BT_ECS_CHUNK_SIZE 0x4000
+#endif
+
+#define BT_NULL_ENTITY 0xFFFFFFFF //!< Entity handle that is never alive
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  //! Handle of an entity. Low 24 bits are the index, high 8 the generation
+  typedef uint32_t Entity;
+  typedef unsigned ComponentID; //!< ID of a given component type
+
+  /*****************************************/
+  /*!
+  \brief
+  Entity component system.
+  Entities with the same set of components share an archetype. Each
+  archetype stores its entities in chunks of BT_ECS_CHUNK_SIZE bytes, with
+  one tightly packed column per component, so iterating a component walks
+  contiguous memory. Components must be plain data: they are moved with
+  memcpy and never constructed or destroyed.
+  Create, Destroy, Add and Remove must not be called while iterating.
+  */
+  /*****************************************/
+  class ECS : public System<ECS>
+  {
+  public:
+    struct Archetype; // Forward declaration
+
+    /*****************************************/
+    /*!
+    \brief
+    Component type ID, given out the first time a type is used.
+
+    \tparam T
+    Type of the component.
+    */
+    /*****************************************/
+    template <typename T>
+    struct Component
+    {
+      static_assert(std::is_trivially_copyable<T>::value,
+        "ECS components are moved with memcpy, so must be trivially copyable");
+      static const ComponentID id; //!< ID of the component
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Block of up to an archetype's capacity entities.
+    The entity column comes first, followed by one column per component.
+    */
+    /*****************************************/
+    struct Chunk
+    {
+      char *data; //!< The columns
+      unsigned count; //!< Entities in the chunk
+      Archetype *archetype; //!< Archetype the chunk belongs to
+
+      /*****************************************/
+      /*!
+      \brief
+      Gets the entity column.
+      */
+      /*****************************************/
+      Entity *Entities() { return (Entity *)data; }
+
+      /*****************************************/
+      /*!
+      \brief
+      Gets a component's column. The archetype must have the component.
+
+      \tparam T
+      Type of the component.
+      */
+      /*****************************************/
+      template <typename T>
+      T *Column();
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Storage for every entity with exactly one set of components.
+    */
+    /*****************************************/
+    struct Archetype
+    {
+      uint64_t mask; //!< Bit per ComponentID the entities have
+      unsigned capacity; //!< Entities per chunk
+      size_t chunksize; //!< Bytes per chunk
+      size_t offsets[BT_MAX_COMPONENTS]; //!< Column offsets by ComponentID
+      std::vector<Chunk *> chunks; //!< Chunks, all full but the last used
+      unsigned count; //!< Entities in the archetype
+      Archetype *addedge[BT_MAX_COMPONENTS]; //!< Archetype with one more
+      Archetype *removeedge[BT_MAX_COMPONENTS]; //!< Archetype with one less
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Cached list of the archetypes matching a set of components.
+    Kept up to date as archetypes are created.
+    */
+    /*****************************************/
+    struct Query
+    {
+      uint64_t include; //!< Components an archetype must have
+      uint64_t exclude; //!< Components an archetype must not have
+      std::vector<Archetype *> archetypes; //!< Matching archetypes
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Default constructor.
+    The ECS only stores entities, so it isn't in any update phase.
+    */
+    /*****************************************/
+    ECS();
+
+    /*****************************************/
+    /*!
+    \brief
+    Destructor. Frees every chunk.
+    */
+    /*****************************************/
+    ~ECS();
+
+    /*****************************************/
+    /*!
+    \brief
+    Does nothing. Systems using the ECS update themselves.
+    */
+    /*****************************************/
+    void Update() {}
+
+    /*****************************************/
+    /*!
+    \brief
+    Creates an entity without components.
+
+    \return
+    Handle of the entity.
+    */
+    /*****************************************/
+    Entity Create();
+
+    /*****************************************/
+    /*!
+    \brief
+    Destroys an entity. Its handle stops being alive and its index is
+    reused with a new generation.
+
+    \param entity
+    Entity to destroy.
+    */
+    /*****************************************/
+    void Destroy(Entity entity);
+
+    /*****************************************/
+    /*!
+    \brief
+    Determines if an entity handle refers to a living entity.
+    */
+    /*****************************************/
+    bool Alive(Entity entity) const;
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the number of living entities.
+    */
+    /*****************************************/
+    unsigned GetCount() const { return living; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Adds a component to an entity, or overwrites it if the entity has it.
+
+    \tparam T
+    Type of the component.
+
+    \param entity
+    Entity to add to.
+
+    \param value
+    Value of the component.
+
+    \return
+    Pointer to the component, valid until the next structural change.
+    nullptr if the entity is dead or there are too many component types.
+    */
+    /*****************************************/
+    template <typename T>
+    T *Add(Entity entity, const T &value = T())
+    {
+      static_assert(std::is_trivially_copyable<T>::value,
+        "ECS components are moved with memcpy, so must be trivially copyable");
+      void *data = AddRaw(entity, Component<T>::id);
+      if (!data) return nullptr;
+      memcpy(data, &value, sizeof(T));
+      return (T *)data;
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Removes a component from an entity.
+
+    \tparam T
+    Type of the component.
+
+    \param entity
+    Entity to remove from.
+    */
+    /*****************************************/
+    template <typename T>
+    void Remove(Entity entity) { RemoveRaw(entity, Component<T>::id); }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets one of an entity's components.
+
+    \tparam T
+    Type of the component.
+
+    \param entity
+    Entity to get from.
+
+    \return
+    Pointer to the component, valid until the next structural change.
+    nullptr if the entity is dead or doesn't have the component.
+    */
+    /*****************************************/
+    template <typename T>
+    T *Get(Entity entity)
+    {
+      static_assert(std::is_trivially_copyable<T>::value,
+        "ECS components are moved with memcpy, so must be trivially copyable");
+      return (T *)GetRaw(entity, Component<T>::id);
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Determines if an entity has a component.
+    */
+    /*****************************************/
+    template <typename T>
+    bool Has(Entity entity) { return GetRaw(entity, Component<T>::id); }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the cached query for a set of components.
+
+    \param include
+    Bit per ComponentID an archetype must have.
+
+    \param exclude
+    Bit per ComponentID an archetype must not have.
+
+    \return
+    Reference to the query, valid for the life of the ECS.
+    */
+    /*****************************************/
+    Query &GetQuery(uint64_t include, uint64_t exclude = 0);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the mask of a set of component types.
+
+    \tparam Ts
+    Types of the components.
+    */
+    /*****************************************/
+    template <typename... Ts>
+    static uint64_t MaskOf()
+    {
+      // The trailing 0 keeps the array valid when Ts is empty
+      ComponentID ids[] = { Component<Ts>::id..., 0 };
+      uint64_t mask = 0;
+      for (unsigned i = 0; i < sizeof...(Ts); ++i)
+      {
+        // Types past the limit are never stored, so match nothing
+        if (ids[i] >= BT_MAX_COMPONENTS) return ~uint64_t(0);
+        mask |= uint64_t(1) << ids[i];
+      }
+      return mask;
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Calls func once per chunk of entities with all of the components.
+    This is the fastest way to iterate.
+
+    \tparam Ts
+    Types of the components.
+
+    \param func
+    Function taking the entity count, the entity column, and one column
+    pointer per component: func(unsigned, Entity *, Ts *...).
+    */
+    /*****************************************/
+    template <typename... Ts, typename F>
+    void ForEachChunk(F func)
+    {
+      Query &query = GetQuery(MaskOf<Ts...>());
+      for (auto arch : query.archetypes)
+        for (auto chunk : arch->chunks)
+          if (chunk->count) RunChunk<Ts...>(func, chunk);
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Calls func once per chunk of entities with all of the components,
+    spreading chunks over the Engine's job system. Returns once every chunk
+    is done. func must be safe to call from several threads at once.
+
+    \tparam Ts
+    Types of the components.
+
+    \param func
+    Function taking the entity count, the entity column, and one column
+    pointer per component: func(unsigned, Entity *, Ts *...).
+
+    \param grain
+    Max number of chunks per job.
+    */
+    /*****************************************/
+    template <typename... Ts, typename F>
+    void ParallelForEachChunk(F func, unsigned grain = 1)
+    {
+      std::vector<Chunk *, ArenaAllocator<Chunk *> > chunks(
+        (ArenaAllocator<Chunk *>(Engine::Get()->GetFrameArena()))
+      );
+      Query &query = GetQuery(MaskOf<Ts...>());
+      for (auto arch : query.archetypes)
+        for (auto chunk : arch->chunks)
+          if (chunk->count) chunks.push_back(chunk);
+      Engine::Get()->GetJobs().ParallelFor(
+        0, chunks.size(), grain,
+        [&func, &chunks](unsigned begin, unsigned end) {
+          for (unsigned i = begin; i < end; ++i)
+            RunChunk<Ts...>(func, chunks[i]);
+        }
+      );
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Calls func once per entity with all of the components.
+
+    \tparam Ts
+    Types of the components.
+
+    \param func
+    Function taking the entity and a reference to each component:
+    func(Entity, Ts &...).
+    */
+    /*****************************************/
+    template <typename... Ts, typename F>
+    void Each(F func)
+    {
+      Query &query = GetQuery(MaskOf<Ts...>());
+      for (auto arch : query.archetypes)
+        for (auto chunk : arch->chunks)
+          if (chunk->count)
+            EachInChunk(
+              func, chunk->count, chunk->Entities(),
+              chunk->template Column<Ts>()...
+            );
+    }
+
+  private:
+    /*****************************************/
+    /*!
+    \brief
+    Where an entity lives.
+    */
+    /*****************************************/
+    struct Record
+    {
+      Archetype *archetype; //!< Archetype of the entity, nullptr if dead
+      unsigned row; //!< Row of the entity within the archetype
+      unsigned generation; //!< Generation of the index's current entity
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Gives out the next ComponentID. Called when Component<T>::id is set.
+
+    \param size
+    Size of the component.
+
+    \param align
+    Alignment of the component.
+    */
+    /*****************************************/
+    static ComponentID RegisterComponent(size_t size, size_t align);
+
+    /*****************************************/
+    /*!
+    \brief
+    Calls func with a chunk's columns.
+    */
+    /*****************************************/
+    template <typename... Ts, typename F>
+    static void RunChunk(F &func, Chunk *chunk)
+    {
+      func(chunk->count, chunk->Entities(), chunk->template Column<Ts>()...);
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Calls func for each row of a chunk's columns.
+    */
+    /*****************************************/
+    template <typename F, typename... Ts>
+    static void EachInChunk(F &func, unsigned count, Entity *e, Ts *...cols)
+    {
+      for (unsigned i = 0; i < count; ++i)
+        func(e[i], cols[i]...);
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Moves an entity to the archetype with one more component.
+
+    \return
+    Pointer to the (uninitialized) component, nullptr on failure.
+    */
+    /*****************************************/
+    void *AddRaw(Entity entity, ComponentID id);
+
+    /*****************************************/
+    /*!
+    \brief
+    Moves an entity to the archetype with one less component.
+    */
+    /*****************************************/
+    void RemoveRaw(Entity entity, ComponentID id);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets a pointer to an entity's component, nullptr if it has none.
+    */
+    /*****************************************/
+    void *GetRaw(Entity entity, ComponentID id);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the archetype with a mask, creating it (and updating the cached
+    queries) if it doesn't exist yet.
+    */
+    /*****************************************/
+    Archetype *GetArchetype(uint64_t mask);
+
+    /*****************************************/
+    /*!
+    \brief
+    Appends an entity to an archetype, adding a chunk if needed.
+
+    \return
+    Row of the entity. Its components are left uninitialized.
+    */
+    /*****************************************/
+    unsigned PushRow(Archetype *arch, Entity entity);
+
+    /*****************************************/
+    /*!
+    \brief
+    Removes a row from an archetype by moving the last row into it.
+    */
+    /*****************************************/
+    void RemoveRow(Archetype *arch, unsigned row);
+
+    /*****************************************/
+    /*!
+    \brief
+    Moves an entity to another archetype, keeping the components both have.
+    */
+    /*****************************************/
+    void Move(Entity entity, Archetype *target);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the address of a row's component.
+    */
+    /*****************************************/
+    static char *Cell(Archetype *arch, unsigned row, ComponentID id);
+
+    std::map<uint64_t, Archetype *> archetypes; //!< Archetypes by mask
+    std::vector<Query *> queries; //!< Cached queries
+    std::vector<Record> records; //!< Entities by index
+    std::vector<unsigned> freeindices; //!< Indices of destroyed entities
+    Archetype *empty; //!< Archetype of entities without components
+    unsigned living; //!< Number of living entities
+  };
+
+  template <typename T>
+  const ComponentID ECS::Component<T>::id =
+    ECS::RegisterComponent(sizeof(T), alignof(T));
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets a component's column. The archetype must have the component.
+
+  \tparam T
+  Type of the component.
+  */
+  /*****************************************/
+  template <typename T>
+  T *ECS::Chunk::Column()
+  {
+    return (T *)(data + archetype->offsets[Component<T>::id]);
+  }
+}
+
+#endif
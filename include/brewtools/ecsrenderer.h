@@ -0,0 +1,96 @@
+/******************************************************************************/
+/*!
+\file ecsrenderer.h
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Components and system for drawing ECS entities through Graphics.
+*/
+/******************************************************************************/
+
+#ifndef __BT_ECSRENDERER_H_
+#define __BT_ECSRENDERER_H_
+
+#include "brewtools/ecs.h"      // ECS class
+#include "brewtools/graphics.h" // Graphics class
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  /*****************************************/
+  /*!
+  \brief
+  Position, rotation and scale of an entity.
+  */
+  /*****************************************/
+  struct Transform
+  {
+    float x; //!< Horizontal position
+    float y; //!< Vertical position
+    float z; //!< Depth
+    float rotation; //!< Rotation = r * pi
+    float scalex; //!< Horizontal scale
+    float scaley; //!< Vertical scale
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Vertex-colored mesh drawn at an entity's Transform.
+  Many entities can share one shape.
+  */
+  /*****************************************/
+  struct ColorMesh
+  {
+    Graphics::Shape *shape; //!< Shape with color vertices, not owned
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Draws every entity with a Transform and a ColorMesh during PHASE_RENDER.
+  */
+  /*****************************************/
+  class ECSRenderer : public System<ECSRenderer>
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    Default constructor.
+    */
+    /*****************************************/
+    ECSRenderer();
+
+    /*****************************************/
+    /*!
+    \brief
+    Draws the entities.
+    */
+    /*****************************************/
+    void Update();
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the number of entities drawn during the last update.
+    */
+    /*****************************************/
+    unsigned GetDrawn() const { return drawn; }
+
+  private:
+    unsigned drawn; //!< Entities drawn during the last update
+  };
+}
+
+#endif
@@ -0,0 +1,482 @@
+/******************************************************************************/
+/*!
+\file events.h
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Typed event bus dispatched by the Engine between update phases.
+*/
+/******************************************************************************/
+
+#ifndef __BT_EVENTS_H_
+#define __BT_EVENTS_H_
+
+#include "brewtools/macros.h" // BT_NO_THREADS
+#include <algorithm>  // std::remove_if
+#include <functional> // std::function
+#include <vector>     // std::vector
+#include <utility>    // std::pair
+
+#ifndef BT_NO_THREADS
+#include <atomic> // std::atomic
+#include <mutex>  // std::mutex
+#include <thread> // std::this_thread
+#endif
+
+#ifndef BT_MAX_EVENT_TYPES
+#define BT_MAX_EVENT_TYPES 64 //!< Max number of event types
+#endif
+
+#ifndef BT_EVENT_RING_SIZE
+//! Events of each type queued without locking. Must be a power of 2
+#define BT_EVENT_RING_SIZE 1024
+#endif
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  typedef unsigned EventTypeID; //!< ID of a given event type
+
+  /*****************************************/
+  /*!
+  \brief
+  Typed event bus.
+  Emit may be called from any thread: events go into a bounded lock-free
+  ring per type, spilling into a locked list once the ring is full. Once
+  an event has spilled, the rest follow it into the list until the next
+  Dispatch, so each thread's events arrive in the order it emitted them.
+  Dispatch, called by the Engine after each update phase, hands every
+  subscriber all of the queued events of its type as one array.
+  Events emitted during Dispatch are delivered by the next one.
+  Subscribers may subscribe and unsubscribe during Dispatch: subscribers
+  added then get events from the next Dispatch on, and ones removed then
+  aren't called again.
+  Subscribe, Unsubscribe and Dispatch must only be called from the main
+  thread.
+  */
+  /*****************************************/
+  class EventBus
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    Event type ID, given out the first time a type is used.
+
+    \tparam T
+    Type of the event.
+    */
+    /*****************************************/
+    template <typename T>
+    struct Type
+    {
+      static const EventTypeID id; //!< ID of the event type
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Default constructor.
+    */
+    /*****************************************/
+    EventBus();
+
+    /*****************************************/
+    /*!
+    \brief
+    Destructor. Drops undelivered events.
+    */
+    /*****************************************/
+    ~EventBus();
+
+    /*****************************************/
+    /*!
+    \brief
+    Queues an event for the next Dispatch. Safe on any thread.
+
+    \tparam T
+    Type of the event.
+
+    \param event
+    Event to queue.
+    */
+    /*****************************************/
+    template <typename T>
+    void Emit(const T &event)
+    {
+      Channel<T> *channel = GetChannel<T>();
+      if (channel) channel->Emit(event);
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Adds a subscriber for a type of event.
+
+    \tparam T
+    Type of the event.
+
+    \param func
+    Function taking the queued events and their count.
+
+    \return
+    Handle for Unsubscribe, 0 if there are too many event types.
+    */
+    /*****************************************/
+    template <typename T>
+    unsigned Subscribe(std::function<void(const T *, unsigned)> func)
+    {
+      Channel<T> *channel = GetChannel<T>();
+      if (!channel) return 0;
+      channel->Add(++lasthandle, func);
+      return lasthandle;
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Removes a subscriber.
+
+    \tparam T
+    Type of the event.
+
+    \param handle
+    Handle returned by Subscribe.
+    */
+    /*****************************************/
+    template <typename T>
+    void Unsubscribe(unsigned handle)
+    {
+      Channel<T> *channel = GetChannel<T>();
+      if (channel) channel->Remove(handle);
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Delivers every queued event to its subscribers.
+    Called by Engine::Update after each phase.
+    */
+    /*****************************************/
+    void Dispatch();
+
+  private:
+    /*****************************************/
+    /*!
+    \brief
+    Untyped part of a channel, so the bus can hold every type together.
+    */
+    /*****************************************/
+    class ChannelBase
+    {
+    public:
+      /*****************************************/
+      /*!
+      \brief
+      Destructor.
+      */
+      /*****************************************/
+      virtual ~ChannelBase() {}
+
+      /*****************************************/
+      /*!
+      \brief
+      Delivers the channel's queued events.
+      */
+      /*****************************************/
+      virtual void Dispatch() = 0;
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Queue and subscribers of one type of event.
+
+    \tparam T
+    Type of the event.
+    */
+    /*****************************************/
+    template <typename T>
+    class Channel : public ChannelBase
+    {
+    public:
+      //! Function subscribers are called with
+      typedef std::function<void(const T *, unsigned)> Func;
+
+      /*****************************************/
+      /*!
+      \brief
+      Default constructor.
+      */
+      /*****************************************/
+      Channel() : dispatching(false), removed(false)
+      #ifndef BT_NO_THREADS
+        , tail(0), head(0), spilled(false)
+      #endif
+      {
+        #ifndef BT_NO_THREADS
+        for (unsigned i = 0; i < BT_EVENT_RING_SIZE; ++i)
+          slots[i].sequence = i;
+        #endif
+      }
+
+      /*****************************************/
+      /*!
+      \brief
+      Adds a subscriber. During Dispatch it's held back until the
+      subscribers have all been called, so the list doesn't move under
+      the one running.
+      */
+      /*****************************************/
+      void Add(unsigned handle, const Func &func)
+      {
+        if (dispatching) added.push_back(std::make_pair(handle, func));
+        else subscribers.push_back(std::make_pair(handle, func));
+      }
+
+      /*****************************************/
+      /*!
+      \brief
+      Removes a subscriber. During Dispatch its handle is zeroed so it
+      isn't called again, and it's erased once Dispatch is done.
+      */
+      /*****************************************/
+      void Remove(unsigned handle)
+      {
+        for (auto it = added.begin(); it != added.end(); ++it)
+        {
+          if (it->first == handle)
+          {
+            added.erase(it);
+            return;
+          }
+        }
+        for (auto it = subscribers.begin(); it != subscribers.end(); ++it)
+        {
+          if (it->first != handle) continue;
+          if (dispatching)
+          {
+            it->first = 0;
+            removed = true;
+          }
+          else subscribers.erase(it);
+          return;
+        }
+      }
+
+      /*****************************************/
+      /*!
+      \brief
+      Queues an event.
+      */
+      /*****************************************/
+      void Emit(const T &event)
+      {
+        #ifndef BT_NO_THREADS
+        // Bounded ring with a sequence number per slot. Producers claim a
+        // slot with a CAS on tail and publish it through its sequence.
+        // After a spill the ring is skipped, so nothing overtakes it
+        unsigned pos = tail.load(std::memory_order_relaxed);
+        while (!spilled.load(std::memory_order_acquire))
+        {
+          Slot &slot = slots[pos & (BT_EVENT_RING_SIZE - 1)];
+          unsigned seq = slot.sequence.load(std::memory_order_acquire);
+          int diff = int(seq - pos);
+          if (diff == 0)
+          {
+            if (tail.compare_exchange_weak(pos, pos + 1,
+                std::memory_order_relaxed))
+            {
+              slot.value = event;
+              slot.sequence.store(pos + 1, std::memory_order_release);
+              return;
+            }
+          }
+          else if (diff < 0)
+            break; // Full
+          else
+            pos = tail.load(std::memory_order_relaxed);
+        }
+        std::lock_guard<std::mutex> lock(overflowlock);
+        spilled.store(true, std::memory_order_relaxed);
+        #endif
+        overflow.push_back(event);
+      }
+
+      /*****************************************/
+      /*!
+      \brief
+      Delivers the queued events as one batch to each subscriber.
+      */
+      /*****************************************/
+      void Dispatch()
+      {
+        // A subscriber dispatching again gets its events next time
+        if (dispatching) return;
+        batch.clear();
+        #ifndef BT_NO_THREADS
+        // Only events queued before now are taken, so subscribers that
+        // emit more don't keep this going
+        Drain(tail.load(std::memory_order_acquire), false);
+        {
+          std::lock_guard<std::mutex> lock(overflowlock);
+          if (!overflow.empty())
+          {
+            // Spilled events may come after ring events queued since the
+            // drain above, those have to be taken first
+            Drain(tail.load(std::memory_order_acquire), true);
+            batch.insert(batch.end(), overflow.begin(), overflow.end());
+            overflow.clear();
+          }
+          spilled.store(false, std::memory_order_relaxed);
+        }
+        #else
+        batch.swap(overflow);
+        #endif
+        if (batch.empty()) return;
+        dispatching = true;
+        for (unsigned i = 0; i < subscribers.size(); ++i)
+        {
+          if (subscribers[i].first)
+            subscribers[i].second(batch.data(), batch.size());
+        }
+        dispatching = false;
+        if (removed)
+        {
+          subscribers.erase(std::remove_if(subscribers.begin(),
+            subscribers.end(), [](const Subscriber &sub) {
+              return sub.first == 0;
+            }), subscribers.end());
+          removed = false;
+        }
+        subscribers.insert(subscribers.end(), added.begin(), added.end());
+        added.clear();
+      }
+
+    private:
+      //! Subscriber and its handle, 0 once removed during Dispatch
+      typedef std::pair<unsigned, Func> Subscriber;
+
+      #ifndef BT_NO_THREADS
+      /*****************************************/
+      /*!
+      \brief
+      Moves the ring's events into the batch, in order.
+
+      \param end
+      Position to stop at.
+
+      \param wait
+      true to wait for slots claimed but not written yet, false to stop
+      at the first one and leave the rest for the next Dispatch.
+      */
+      /*****************************************/
+      void Drain(unsigned end, bool wait)
+      {
+        while (head != end)
+        {
+          Slot &slot = slots[head & (BT_EVENT_RING_SIZE - 1)];
+          if (slot.sequence.load(std::memory_order_acquire) != head + 1)
+          {
+            if (!wait) return;
+            std::this_thread::yield(); // Its producer is writing it
+            continue;
+          }
+          batch.push_back(slot.value);
+          slot.sequence.store(
+            head + BT_EVENT_RING_SIZE, std::memory_order_release
+          );
+          ++head;
+        }
+      }
+      #endif
+
+      std::vector<Subscriber> subscribers; //!< Called by Dispatch
+      std::vector<Subscriber> added; //!< Subscribed during Dispatch
+      bool dispatching; //!< Determines if subscribers are being called
+      bool removed; //!< Set when a subscriber is removed during Dispatch
+
+      #ifndef BT_NO_THREADS
+      /*****************************************/
+      /*!
+      \brief
+      Slot of the ring.
+      */
+      /*****************************************/
+      struct Slot
+      {
+        std::atomic<unsigned> sequence; //!< Position the slot is ready for
+        T value; //!< The event
+      };
+
+      Slot slots[BT_EVENT_RING_SIZE]; //!< The ring
+      std::atomic<unsigned> tail; //!< Next position producers claim
+      unsigned head; //!< Next position Dispatch reads
+      std::mutex overflowlock; //!< Guards overflow
+      std::atomic<bool> spilled; //!< Emits go to overflow until Dispatch
+      #endif
+      std::vector<T> overflow; //!< Events that didn't fit in the ring
+      std::vector<T> batch; //!< Events being delivered
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Gives out the next EventTypeID. Called when Type<T>::id is set.
+    */
+    /*****************************************/
+    static EventTypeID RegisterType();
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the channel of a type, creating it on first use.
+
+    \return
+    Pointer to the channel, nullptr if there are too many event types.
+    */
+    /*****************************************/
+    template <typename T>
+    Channel<T> *GetChannel()
+    {
+      EventTypeID id = Type<T>::id;
+      if (id >= BT_MAX_EVENT_TYPES) return nullptr;
+      ChannelBase *channel = channels[id];
+      if (channel) return static_cast<Channel<T> *>(channel);
+      ChannelBase *created = new Channel<T>;
+      #ifndef BT_NO_THREADS
+      // Another thread may win the race to create it
+      if (!channels[id].compare_exchange_strong(channel, created))
+      {
+        delete created;
+        return static_cast<Channel<T> *>(channel);
+      }
+      #else
+      channels[id] = created;
+      #endif
+      return static_cast<Channel<T> *>(created);
+    }
+
+    #ifndef BT_NO_THREADS
+    std::atomic<ChannelBase *> channels[BT_MAX_EVENT_TYPES]; //!< By type
+    #else
+    ChannelBase *channels[BT_MAX_EVENT_TYPES]; //!< Channels by type
+    #endif
+    unsigned lasthandle; //!< Last handle given out by Subscribe
+  };
+
+  template <typename T>
+  const EventTypeID EventBus::Type<T>::id = EventBus::RegisterType();
+}
+
+#endif
@@ -37,7 +37,7 @@ Window for displaying graphics using OpenGL.
    GX_TRANSFER_RAW_COPY(0) | GX_TRANSFER_IN_FORMAT(GX_TRANSFER_FMT_RGBA8) | \
    GX_TRANSFER_OUT_FORMAT(GX_TRANSFER_FMT_RGB8) |                           \
    GX_TRANSFER_SCALING(GX_TRANSFER_SCALE_NO))
-#elif _WIN32
+#else // Windows, and headless host builds
 #define DEFAULT_WINDOW_WIDTH 1280
 #define DEFAULT_WINDOW_HEIGHT 720
 #endif
@@ -270,8 +270,7 @@ namespace BrewTools
       return target;
     #else
       Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
-      if (trace)
-        (*trace)[5] << "GFXWindow::GetTarget() only works on 3DS";
+      BT_TRACE_TO(trace, 5, "GFXWindow::GetTarget() only works on 3DS");
       return nullptr;
     #endif
     }
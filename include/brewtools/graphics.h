@@ -72,6 +72,8 @@ Alpha value of the color.
 #endif
 //! Default depth (Z coordinate) to draw the textures to
 #define BT_DEFAULT_DEPTH 0.5f
+//! Vertices per job when preparing large shapes on the job system
+#define BT_SHAPE_PREP_GRAIN 4096
 
 /*****************************************/
 /*!
@@ -169,6 +171,14 @@ namespace BrewTools
       */
       /*****************************************/
       pos_2d(float xpos, float ypos) : x(xpos), y(ypos) {}
+
+      /*****************************************/
+      /*!
+      \brief
+      Copy constructor
+      */
+      /*****************************************/
+      pos_2d(const pos_2d &) = default;
       
       /*****************************************/
       /*!
@@ -238,6 +248,14 @@ namespace BrewTools
       /*****************************************/
       pos_3d(float xpos, float ypos, float zpos = BT_DEFAULT_DEPTH)
       : pos_2d(xpos, ypos), z(zpos) {}
+
+      /*****************************************/
+      /*!
+      \brief
+      Copy constructor
+      */
+      /*****************************************/
+      pos_3d(const pos_3d &) = default;
       
       /*****************************************/
       /*!
@@ -329,6 +347,14 @@ namespace BrewTools
       pos_4d
       (float xpos, float ypos, float zpos = BT_DEFAULT_DEPTH, float wpos = 0.0f)
       : pos_3d(xpos, ypos, zpos), w(wpos) {}
+
+      /*****************************************/
+      /*!
+      \brief
+      Copy constructor
+      */
+      /*****************************************/
+      pos_4d(const pos_4d &) = default;
       
       /*****************************************/
       /*!
@@ -783,6 +809,19 @@ namespace BrewTools
       /*****************************************/
       vertex_col() {}
 
+      /*****************************************/
+      /*!
+      \brief
+      Copy constructor. The color references are bound to the copy's own
+      members, not the original's.
+
+      \param rhs
+      Vertex to copy
+      */
+      /*****************************************/
+      vertex_col(const vertex_col &rhs)
+      : vertex(rhs), r(rhs.r), g(rhs.g), b(rhs.b), a(rhs.a) {}
+
       /*****************************************/
       /*!
       \brief
@@ -813,6 +852,23 @@ namespace BrewTools
     {
     public:
       pos_2d uv; //!< Color
+
+      /*****************************************/
+      /*!
+      \brief
+      Default Constructor
+      */
+      /*****************************************/
+      vertex_tex() = default;
+
+      /*****************************************/
+      /*!
+      \brief
+      Copy constructor
+      */
+      /*****************************************/
+      vertex_tex(const vertex_tex &) = default;
+
       /*****************************************/
       /*!
       \brief
@@ -850,6 +906,22 @@ namespace BrewTools
       bool tile; //!< Determines if the texture is tiling
       unsigned width; //!< Width of texture
       unsigned height; //!< Height of texture
+
+      /*****************************************/
+      /*!
+      \brief
+      Default Constructor
+      */
+      /*****************************************/
+      texture() = default;
+
+      /*****************************************/
+      /*!
+      \brief
+      Copy constructor
+      */
+      /*****************************************/
+      texture(const texture &) = default;
       
       /*****************************************/
       /*!
@@ -872,8 +944,6 @@ namespace BrewTools
     class Shape
     {
     private:
-      //! Color vertices directly used in drawing
-      std::vector<vertex_col> vc;
       //! Texture vertices directly used in drawing
       std::vector<vertex_tex> vt;
     public:
@@ -948,38 +1018,22 @@ namespace BrewTools
       void Print()
       {
         std::cout << "Shape: {" << std::endl;
-        float *vcf = (float*)(vc.data());
-
-        //// Used to determine offsets
-        //std::cout << "vertex[0]:       " << &vertc[0] << std::endl;
-        //std::cout << "vertex[0].pos:   " << &vertc[0].pos << std::endl;
-        //std::cout << "vertex[0].pos.x: " << &vertc[0].pos.x << std::endl;
-        //std::cout << "vertex[0].pos.y: " << &vertc[0].pos.y << std::endl;
-        //std::cout << "vertex[0].pos.z: " << &vertc[0].pos.z << std::endl;
-        //std::cout << "vertex[0].r:     " << &vertc[0].r << std::endl;
-        //std::cout << "vertex[0].g:     " << &vertc[0].g << std::endl;
-        //std::cout << "vertex[0].b:     " << &vertc[0].b << std::endl;
-        //std::cout << "vertex[0].a:     " << &vertc[0].a << std::endl;
-        //std::cout << "vertex[1]:       " << &vertc[1] << std::endl;
-
         for (unsigned i = 0; i < vertc.size(); ++i)
         {
+          vertex_col v = ColorVertex(i);
           std::cout << "  {" << std::endl;
           // Print position
-          // Start with 4 bytes of padding (1 float)
-          std::cout << "    (" << *(vcf + 1 + i * 12)
-                    << ","     << *(vcf + 2 + i * 12)
-                    << ","     << *(vcf + 3 + i * 12)
+          std::cout << "    (" << v.pos.x
+                    << ","     << v.pos.y
+                    << ","     << v.pos.z
                     << ")," << std::endl;
           // Print color
-          std::cout << "    (" << *(vcf + 4 + i * 12)
-                    << ","     << *(vcf + 5 + i * 12)
-                    << ","     << *(vcf + 6 + i * 12)
-                    << ","     << *(vcf + 7 + i * 12)
+          std::cout << "    (" << v.r
+                    << ","     << v.g
+                    << ","     << v.b
+                    << ","     << v.a
                     << ")" << std::endl;
           std::cout << "  }" << std::endl;
-          // Skip the next 20 bytes of padding (5 floats)
-          //   totalling a 12 float offset
         }
         std::cout << "}" << std::endl;
       }
@@ -1675,6 +1729,30 @@ namespace BrewTools
     /*****************************************/
     void Update();
     
+    /*****************************************/
+    /*!
+    \brief
+    Determines if Graphics was created headless. See Engine::SetHeadless.
+    */
+    /*****************************************/
+    bool IsHeadless() const { return headless; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the number of shapes drawn during the last frame.
+    */
+    /*****************************************/
+    unsigned GetDrawCount() const { return lastdraws; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the number of vertices drawn during the last frame.
+    */
+    /*****************************************/
+    unsigned GetVertexCount() const { return lastvertices; }
+
     /*****************************************/
     /*!
     \brief
@@ -1773,10 +1851,9 @@ namespace BrewTools
     {
     #ifdef _WIN32 // The following only exists in a Windows build
       return shaderProgram;
-    #elif _3DS // The following will only exist in a 3DS build
+    #else // The following exists in every other build
       Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
-      if (trace)
-        (*trace)[5] << "Graphics::GetShader() only works on Windows";
+      BT_TRACE_TO(trace, 5, "Graphics::GetShader() only works on Windows");
       return -1;
     #endif
     }
@@ -1810,10 +1887,9 @@ namespace BrewTools
     {
     #ifdef _WIN32 // The following only exists in a Windows build
       return VAO;
-    #elif _3DS // The following will only exist in a 3DS build
+    #else // The following exists in every other build
       Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
-      if (trace)
-        (*trace)[5] << "Graphics::GetVAO() only works on Windows";
+      BT_TRACE_TO(trace, 5, "Graphics::GetVAO() only works on Windows");
       return 0;
     #endif
     }
@@ -1831,10 +1907,9 @@ namespace BrewTools
     {
     #ifdef _WIN32 // The following only exists in a Windows build
       return VBO;
-    #elif _3DS // The following will only exist in a 3DS build
+    #else // The following exists in every other build
       Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
-      if (trace)
-        (*trace)[5] << "Graphics::GetVBO() only works on Windows";
+      BT_TRACE_TO(trace, 5, "Graphics::GetVBO() only works on Windows");
       return 0;
     #endif
     }
@@ -1852,10 +1927,9 @@ namespace BrewTools
     {
     #ifdef _WIN32 // The following only exists in a Windows build
       return EBO;
-    #elif _3DS // The following will only exist in a 3DS build
+    #else // The following exists in every other build
       Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
-      if (trace)
-        (*trace)[5] << "Graphics::GetEBO() only works on Windows";
+      BT_TRACE_TO(trace, 5, "Graphics::GetEBO() only works on Windows");
       return 0;
     #endif
     }
@@ -1873,10 +1947,9 @@ namespace BrewTools
     {
     #ifdef _WIN32 // The following only exists in a Windows build
       return shaderProgram;
-    #elif _3DS // The following will only exist in a 3DS build
+    #else // The following exists in every other build
       Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
-      if (trace)
-        (*trace)[5] << "Graphics::GetProgram() only works on Windows";
+      BT_TRACE_TO(trace, 5, "Graphics::GetProgram() only works on Windows");
       return 0;
     #endif
     }
@@ -1929,6 +2002,11 @@ namespace BrewTools
     std::vector<GFXWindow *> windows; //!< Vector of created GFXWindow
     GFXWindow *currentwindow;         //!< Currently selected window
     bool frameStarted; //!< Determines if a frame has been started
+    bool headless; //!< Determines if there is no window or GPU context
+    unsigned draws; //!< Shapes drawn so far this frame
+    unsigned vertices; //!< Vertices drawn so far this frame
+    unsigned lastdraws; //!< Shapes drawn during the last frame
+    unsigned lastvertices; //!< Vertices drawn during the last frame
   };
 }
 
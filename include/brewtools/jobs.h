@@ -0,0 +1,312 @@
+/******************************************************************************/
+/*!
+\file jobs.h
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Work-stealing job system owned by the Engine.
+*/
+/******************************************************************************/
+
+#ifndef __BT_JOBS_H_
+#define __BT_JOBS_H_
+
+#include "brewtools/macros.h" // BT_NO_THREADS
+#include <functional> // std::function
+
+#ifndef BT_NO_THREADS
+#include <atomic>             // std::atomic
+#include <deque>              // std::deque
+#include <vector>             // std::vector
+#include <thread>             // std::thread
+#include <mutex>              // std::mutex
+#include <condition_variable> // std::condition_variable
+#endif
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  class JobSystem; // Forward declaration
+
+  /*****************************************/
+  /*!
+  \brief
+  Group of jobs that can be waited on together.
+  A continuation given to Then is run as a job once every job in the group
+  has finished. Run must not be called after Then or Wait.
+  */
+  /*****************************************/
+  class TaskGroup
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    Default constructor.
+
+    \param jobs
+    Job system to run on. nullptr uses the Engine's job system.
+    */
+    /*****************************************/
+    TaskGroup(JobSystem *jobs = nullptr);
+
+    /*****************************************/
+    /*!
+    \brief
+    Destructor. Waits for all jobs in the group.
+    */
+    /*****************************************/
+    ~TaskGroup();
+
+    /*****************************************/
+    /*!
+    \brief
+    Adds a job to the group.
+
+    \param func
+    Function to run.
+    */
+    /*****************************************/
+    void Run(std::function<void()> func);
+
+    /*****************************************/
+    /*!
+    \brief
+    Closes the group and sets a job to run once all of its jobs finish.
+    The group is only done once the continuation has run.
+
+    \param func
+    Function to run after the group's jobs.
+    */
+    /*****************************************/
+    void Then(std::function<void()> func);
+
+    /*****************************************/
+    /*!
+    \brief
+    Closes the group and runs other jobs until it is done.
+    */
+    /*****************************************/
+    void Wait();
+
+    /*****************************************/
+    /*!
+    \brief
+    Determines if every job (and the continuation) has finished.
+    */
+    /*****************************************/
+    bool Done() const;
+
+  private:
+    friend JobSystem; //!< Lets the job system finish jobs
+
+    /*****************************************/
+    /*!
+    \brief
+    Drops a reference to the group, scheduling the continuation or marking
+    the group done when the last one goes.
+    */
+    /*****************************************/
+    void Release();
+
+    JobSystem *jobs; //!< Job system the group runs on
+    std::function<void()> continuation; //!< Run after all jobs
+    bool closed; //!< Determines if Then or Wait has been called
+    #ifndef BT_NO_THREADS
+    std::atomic<unsigned> count; //!< Unfinished jobs plus the creator's ref
+    std::atomic<bool> done; //!< Set once everything has finished
+    #else
+    unsigned count; //!< Unfinished jobs plus the creator's ref
+    bool done; //!< Set once everything has finished
+    #endif
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Work-stealing job scheduler.
+  Each worker owns a deque: it pushes and pops jobs at the back while idle
+  workers steal from the front of the others. Threads that are not workers
+  (such as the one calling Engine::Update) push to a shared queue.
+  */
+  /*****************************************/
+  class JobSystem
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    A unit of work.
+    */
+    /*****************************************/
+    struct Job
+    {
+      std::function<void()> func; //!< Function to run
+      TaskGroup *group; //!< Group to notify once done, may be nullptr
+      bool continuation; //!< Determines if this is the group's continuation
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Default constructor. Starts with no workers.
+    */
+    /*****************************************/
+    JobSystem();
+
+    /*****************************************/
+    /*!
+    \brief
+    Destructor. Stops all workers.
+    */
+    /*****************************************/
+    ~JobSystem();
+
+    /*****************************************/
+    /*!
+    \brief
+    Sets the number of worker threads.
+    Must not be called while jobs are in flight.
+
+    \param count
+    Number of workers. With 0, jobs are run by threads waiting on them.
+    */
+    /*****************************************/
+    void SetWorkerCount(unsigned count);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the number of worker threads.
+    */
+    /*****************************************/
+    unsigned GetWorkerCount() const;
+
+    /*****************************************/
+    /*!
+    \brief
+    Pushes a job.
+
+    \param job
+    Job to push.
+    */
+    /*****************************************/
+    void Push(Job job);
+
+    /*****************************************/
+    /*!
+    \brief
+    Pushes a job that isn't part of any group.
+
+    \param func
+    Function to run.
+    */
+    /*****************************************/
+    void Push(std::function<void()> func);
+
+    /*****************************************/
+    /*!
+    \brief
+    Runs a single pending job on the calling thread if there is one.
+
+    \return
+    true if a job was run.
+    */
+    /*****************************************/
+    bool TryRunOne();
+
+    /*****************************************/
+    /*!
+    \brief
+    Calls func over [begin, end) split into chunks of at most grain.
+    The calling thread helps until every chunk is done.
+
+    \param begin
+    First index.
+
+    \param end
+    One past the last index.
+
+    \param grain
+    Max number of indices per chunk.
+
+    \param func
+    Function taking a chunk's first and one-past-last indices.
+    */
+    /*****************************************/
+    void ParallelFor(
+      unsigned begin, unsigned end, unsigned grain,
+      std::function<void(unsigned, unsigned)> func
+    );
+
+  private:
+    /*****************************************/
+    /*!
+    \brief
+    Runs a job and notifies its group.
+
+    \param job
+    Job to run.
+    */
+    /*****************************************/
+    void Execute(Job &job);
+
+    #ifndef BT_NO_THREADS
+    /*****************************************/
+    /*!
+    \brief
+    Queue of jobs with its own lock.
+    */
+    /*****************************************/
+    struct Queue
+    {
+      std::mutex lock; //!< Guards jobs
+      std::deque<Job> jobs; //!< Pending jobs
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Takes a job from the calling thread's own queue or steals one.
+
+    \param job
+    Filled with the job taken.
+
+    \return
+    true if a job was taken.
+    */
+    /*****************************************/
+    bool Take(Job &job);
+
+    /*****************************************/
+    /*!
+    \brief
+    Loop run by each worker thread.
+
+    \param index
+    Index of the worker's queue.
+    */
+    /*****************************************/
+    void WorkerLoop(unsigned index);
+
+    std::vector<std::thread> workers; //!< Worker threads
+    std::vector<Queue *> queues; //!< Shared queue followed by one per worker
+    std::atomic<unsigned> queued; //!< Number of pending jobs
+    std::mutex sleeplock; //!< Used by idle workers to sleep
+    std::condition_variable sleepcv; //!< Wakes idle workers
+    bool stopping; //!< Tells workers to exit
+    #endif
+  };
+}
+
+#endif
@@ -32,4 +32,15 @@ Safely deletes and sets a pointer to an array to nullptr.
 /*****************************************/
 #define SAFE_DELETE_ARR(x) {if (x) {delete[] (x); (x) = nullptr;}}
 
+#if defined(_3DS) || defined(_WIIU)
+/*****************************************/
+/*!
+\brief
+Defined on platforms without std::thread support.
+Jobs are run as they are pushed and systems are always updated serially.
+*/
+/*****************************************/
+#define BT_NO_THREADS
+#endif
+
 #endif
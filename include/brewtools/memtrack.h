@@ -0,0 +1,162 @@
+/******************************************************************************/
+/*!
+\file memtrack.h
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Heap allocation accounting per system.
+*/
+/******************************************************************************/
+
+#ifndef __BT_MEMTRACK_H_
+#define __BT_MEMTRACK_H_
+
+#include "brewtools/system.h" // SysID
+#include <cstdint> // uint64_t
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  class Trace; // Forward declaration
+
+  /*****************************************/
+  /*!
+  \brief
+  Allocation statistics of one system.
+  */
+  /*****************************************/
+  struct AllocStats
+  {
+    uint64_t live; //!< Bytes allocated and not yet freed
+    uint64_t highwater; //!< Most live bytes seen
+    uint64_t bytes; //!< Bytes allocated during the last frame
+    uint64_t allocs; //!< Allocations during the last frame
+    uint64_t frees; //!< Frees during the last frame
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Attributes heap allocations to systems.
+  When BT_TRACK_ALLOCATIONS is defined, the global operator new and delete
+  are replaced with versions that count every allocation against the
+  calling thread's tag. Engine::Update tags each system's update with its
+  SysID, anything else is counted against tag 0.
+  Without BT_TRACK_ALLOCATIONS every statistic reads 0.
+  */
+  /*****************************************/
+  class MemTrack
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    Sets the calling thread's tag.
+
+    \param tag
+    SysID to count allocations against, 0 for none.
+
+    \return
+    The previous tag.
+    */
+    /*****************************************/
+    static SysID SetTag(SysID tag);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the calling thread's tag.
+    */
+    /*****************************************/
+    static SysID GetTag();
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets a tag's statistics.
+
+    \param tag
+    SysID to get, 0 for untagged allocations.
+    */
+    /*****************************************/
+    static AllocStats GetStats(SysID tag);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the heap allocations made during the last frame by every tag,
+    counted by the operator new replacement. The number that should be 0
+    for steady-state scenes. Always 0 without BT_TRACK_ALLOCATIONS.
+    */
+    /*****************************************/
+    static uint64_t GetFrameAllocations();
+
+    /*****************************************/
+    /*!
+    \brief
+    Ends the frame, moving the per-frame counters into the last frame's
+    statistics. Called by the default Engine's Update: the counters are
+    process wide, so other Engines' frames leave them alone.
+    */
+    /*****************************************/
+    static void EndFrame();
+
+    /*****************************************/
+    /*!
+    \brief
+    Writes every tag with allocations to a Trace.
+
+    \param trace
+    Trace to write to.
+
+    \param level
+    Trace level to write at.
+    */
+    /*****************************************/
+    static void Dump(Trace &trace, unsigned level);
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Tags the calling thread's allocations for the life of the object.
+  */
+  /*****************************************/
+  class AllocTag
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    Conversion constructor. Sets the tag.
+
+    \param tag
+    SysID to count allocations against.
+    */
+    /*****************************************/
+    AllocTag(SysID tag) : previous(MemTrack::SetTag(tag)) {}
+
+    /*****************************************/
+    /*!
+    \brief
+    Destructor. Restores the previous tag.
+    */
+    /*****************************************/
+    ~AllocTag() { MemTrack::SetTag(previous); }
+
+  private:
+    SysID previous; //!< Tag to restore
+  };
+}
+
+#endif
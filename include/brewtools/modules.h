@@ -0,0 +1,259 @@
+/******************************************************************************/
+/*!
+\file modules.h
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Systems loaded from shared objects and reloaded when they change.
+*/
+/******************************************************************************/
+
+#ifndef __BT_MODULES_H_
+#define __BT_MODULES_H_
+
+#include "brewtools/system.h" // ProtoSystem class, SysID
+#include <cstdint> // uint64_t
+#include <string>  // std::string
+
+#ifndef BT_MAX_MODULES
+#define BT_MAX_MODULES 16 //!< Max number of modules loaded at once
+#endif
+
+#ifndef BT_MODULE_POLL
+#define BT_MODULE_POLL 250000 //!< Microseconds between module file checks
+#endif
+
+/*****************************************/
+/*!
+\brief
+Exports a system from a module. Put it in exactly one source file of the
+shared object.
+
+\param T
+System class to create. Should derive from ModuleSystem.
+
+\param name
+Name of the module, used by Modules::Find and profile dumps.
+*/
+/*****************************************/
+#define BT_MODULE(T, name) \
+  extern "C" BrewTools::ProtoSystem *BrewToolsCreateModule() \
+  { return new T; } \
+  extern "C" const char *BrewToolsModuleName() { return name; }
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  class Engine; // Forward declaration
+
+  /*****************************************/
+  /*!
+  \brief
+  Base class for systems exported by modules.
+  Unlike System<T>, it doesn't take a SysID when its shared object is
+  loaded: each module is given one SysID that every reload reuses.
+  */
+  /*****************************************/
+  class ModuleSystem : public ProtoSystem
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    Default constructor.
+    */
+    /*****************************************/
+    ModuleSystem() {}
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Loads systems from shared objects at runtime, and reloads them when
+  their file changes.
+  Files are checked every BT_MODULE_POLL us at the start of
+  Engine::Update, while no system is updating. A changed module is
+  loaded and its system created before the old one is touched, so a
+  module that fails to load leaves the old system running. The old
+  system's Serialize output is handed to the new system's Deserialize,
+  then the new system takes the old one's place in the registry and the
+  old shared object is closed.
+  Only supported on Linux. The executable must be linked with -rdynamic
+  (and -ldl on older glibc) so modules use its BrewTools symbols instead
+  of their own, and modules shouldn't link libbrewtools themselves.
+  Building modules with -fno-gnu-unique lets closed modules be unmapped.
+  Modules must undo everything that points into their code (event
+  subscriptions, jobs) in their system's destructor.
+  */
+  /*****************************************/
+  class Modules
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    Conversion constructor.
+
+    \param engine
+    Engine whose registry the modules' systems go in.
+    */
+    /*****************************************/
+    Modules(Engine *engine);
+
+    /*****************************************/
+    /*!
+    \brief
+    Destructor. Closes every module. Their systems must already be
+    deleted.
+    */
+    /*****************************************/
+    ~Modules();
+
+    /*****************************************/
+    /*!
+    \brief
+    Loads a module and adds its system to the Engine.
+
+    \param path
+    Path of the shared object.
+
+    \return
+    SysID of the module's system, 0 on failure.
+    */
+    /*****************************************/
+    SysID Load(const char *path);
+
+    /*****************************************/
+    /*!
+    \brief
+    Reloads a module now, whether its file changed or not.
+    Must only be called from the main thread between Engine updates.
+
+    \param id
+    SysID returned by Load.
+
+    \return
+    true if the new module replaced the old one.
+    */
+    /*****************************************/
+    bool Reload(SysID id);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the SysID of a loaded module.
+
+    \param name
+    Name given to BT_MODULE.
+
+    \return
+    SysID of the module's system, 0 if there is no such module.
+    */
+    /*****************************************/
+    SysID Find(const char *name) const;
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets a module's system. The pointer changes when the module reloads.
+
+    \param id
+    SysID returned by Load.
+
+    \return
+    Pointer to the system, nullptr if id isn't a module.
+    */
+    /*****************************************/
+    ProtoSystem *Get(SysID id) const;
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets how many times modules have been reloaded.
+    */
+    /*****************************************/
+    unsigned GetReloadCount() const { return reloads; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Reloads every module whose file changed and has stopped changing.
+    Called by Engine::Update before the first phase.
+    */
+    /*****************************************/
+    void Poll();
+
+  private:
+    /*****************************************/
+    /*!
+    \brief
+    A loaded module.
+    */
+    /*****************************************/
+    struct Module
+    {
+      std::string path; //!< Path of the shared object
+      std::string name; //!< Name given to BT_MODULE
+      void *handle; //!< Handle of the loaded copy, nullptr if unused
+      SysID id; //!< SysID of the module's system
+      unsigned generation; //!< Number of times the module was loaded
+      uint64_t stamp; //!< Modification time and size of the loaded file
+      uint64_t seen; //!< Stamp seen by the last Poll
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Opens a private copy of a module's file, so a reload never gets
+    the copy already open.
+
+    \param module
+    Module to open.
+
+    \param create
+    Filled with the module's factory.
+
+    \return
+    Handle of the copy, nullptr on failure.
+    */
+    /*****************************************/
+    void *Open(Module &module, ProtoSystem *(**create)());
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets a file's modification time and size mixed into one value.
+
+    \return
+    The stamp, 0 if the file can't be read.
+    */
+    /*****************************************/
+    static uint64_t Stamp(const std::string &path);
+
+    /*****************************************/
+    /*!
+    \brief
+    Writes a module error through Trace.
+    */
+    /*****************************************/
+    void Error(const std::string &message);
+
+    Engine *engine; //!< Engine the modules' systems are in
+    Module modules[BT_MAX_MODULES]; //!< Loaded modules
+    unsigned count; //!< Number of used modules
+    unsigned reloads; //!< Times modules have been reloaded
+    uint64_t lastpoll; //!< Time of the last file check in us
+  };
+}
+
+#endif
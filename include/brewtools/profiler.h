@@ -0,0 +1,239 @@
+/******************************************************************************/
+/*!
+\file profiler.h
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Per-system frame profiler filled in by Engine::Update.
+*/
+/******************************************************************************/
+
+#ifndef __BT_PROFILER_H_
+#define __BT_PROFILER_H_
+
+#include "brewtools/system.h" // SysID, BT_MAX_SYSTEMS
+#include <cstdint> // uint64_t, uint32_t
+
+#ifndef BT_PROFILE_SAMPLES
+//! Number of frames kept for each system's rolling statistics
+#define BT_PROFILE_SAMPLES 128
+#endif
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  class Trace; // Forward declaration
+
+  /*****************************************/
+  /*!
+  \brief
+  Rolling timing statistics over the last BT_PROFILE_SAMPLES frames.
+  All times are in microseconds.
+  */
+  /*****************************************/
+  struct ProfileStats
+  {
+    uint64_t min; //!< Fastest frame
+    uint64_t avg; //!< Mean frame
+    uint64_t p95; //!< 95th percentile frame
+    uint64_t p99; //!< 99th percentile frame
+    uint64_t max; //!< Slowest frame
+    unsigned samples; //!< Number of frames the statistics cover
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Times each system's updates and whole frames.
+  A system's time for a frame is the sum of all of its updates (every
+  phase and fixed step). Recording is two clock reads and an add per
+  update, percentiles are only worked out when queried.
+  */
+  /*****************************************/
+  class Profiler
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    Default constructor. Profiling starts enabled.
+    */
+    /*****************************************/
+    Profiler();
+
+    /*****************************************/
+    /*!
+    \brief
+    Turns profiling on or off.
+    */
+    /*****************************************/
+    void SetEnabled(bool enable) { enabled = enable; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Determines if profiling is on.
+    */
+    /*****************************************/
+    bool IsEnabled() const { return enabled; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Adds time to a system's current frame. Only one thread updates a given
+    system at a time, so this needs no locking.
+
+    \param id
+    ID of the system.
+
+    \param us
+    Microseconds spent.
+    */
+    /*****************************************/
+    void Record(SysID id, uint64_t us) { current[id] += us; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the time a system has spent so far this frame.
+
+    \param id
+    ID of the system.
+    */
+    /*****************************************/
+    uint64_t GetCurrent(SysID id) const
+    {
+      return (id < BT_MAX_SYSTEMS) ? current[id] : 0;
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Ends the frame, pushing a sample for the frame and every system that
+    was scheduled this frame. Called by Engine::Update.
+
+    \param us
+    Microseconds the whole frame took.
+
+    \param scheduled
+    Bit per SysID of the systems scheduled this frame.
+    */
+    /*****************************************/
+    void EndFrame(uint64_t us, uint64_t scheduled);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the rolling statistics of a system.
+
+    \param id
+    ID of the system.
+    */
+    /*****************************************/
+    ProfileStats GetStats(SysID id) const;
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the rolling statistics of a system.
+
+    \tparam T
+    Type of the system.
+    */
+    /*****************************************/
+    template <typename T>
+    ProfileStats GetStats() const { return GetStats(T::id); }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the rolling statistics of whole frames.
+    */
+    /*****************************************/
+    ProfileStats GetFrameStats() const;
+
+    /*****************************************/
+    /*!
+    \brief
+    Names a system for dumps. Systems without a name show their SysID.
+
+    \param id
+    ID of the system.
+
+    \param name
+    Name of the system. Must outlive the profiler.
+    */
+    /*****************************************/
+    void SetName(SysID id, const char *name);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the name of a system, nullptr if it doesn't have one.
+    */
+    /*****************************************/
+    const char *GetName(SysID id) const;
+
+    /*****************************************/
+    /*!
+    \brief
+    Writes the frame and every profiled system's statistics to a Trace.
+
+    \param trace
+    Trace to write to.
+
+    \param level
+    Trace level to write at.
+    */
+    /*****************************************/
+    void Dump(Trace &trace, unsigned level) const;
+
+  private:
+    /*****************************************/
+    /*!
+    \brief
+    Ring of the last BT_PROFILE_SAMPLES frame times.
+    */
+    /*****************************************/
+    struct Ring
+    {
+      uint32_t samples[BT_PROFILE_SAMPLES]; //!< Frame times in microseconds
+      unsigned count; //!< Number of valid samples
+      unsigned next; //!< Index the next sample goes to
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Adds a sample to a ring, overwriting the oldest once full.
+    */
+    /*****************************************/
+    static void Push(Ring &ring, uint64_t us);
+
+    /*****************************************/
+    /*!
+    \brief
+    Works out the statistics of a ring.
+    */
+    /*****************************************/
+    static ProfileStats Compute(const Ring &ring);
+
+    Ring systems[BT_MAX_SYSTEMS]; //!< Samples of each system by SysID
+    Ring frames; //!< Samples of whole frames
+    uint64_t current[BT_MAX_SYSTEMS]; //!< Time of each system this frame
+    const char *names[BT_MAX_SYSTEMS]; //!< Names of systems for dumps
+    bool enabled; //!< Determines if the Engine records timings
+  };
+}
+
+#endif
@@ -0,0 +1,384 @@
+/******************************************************************************/
+/*!
+\file recorder.h
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Records a session's external inputs frame by frame and replays them.
+*/
+/******************************************************************************/
+
+#ifndef __BT_RECORDER_H_
+#define __BT_RECORDER_H_
+
+#include "brewtools/events.h" // EventBus class
+#include "brewtools/macros.h" // BT_NO_THREADS
+#include <cstdint> // uint64_t, uint32_t
+#include <fstream> // std::ofstream
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+#ifndef BT_NO_THREADS
+#include <mutex> // std::mutex
+#endif
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  /*****************************************/
+  /*!
+  \brief
+  Sent through Recorder::Input when a window's framebuffer is resized.
+  */
+  /*****************************************/
+  struct WindowResizeEvent
+  {
+    int width; //!< New width in pixels
+    int height; //!< New height in pixels
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Records everything from outside that a session depends on, and feeds
+  it back so the session plays out the same way again.
+  Each frame records:
+  - the time Time::Current returns, which is frozen for the frame while
+    recording or replaying
+  - the time the fixed step accumulates (see Engine::SetFixedStep)
+  - the inputs passed to Input, with the phase they came in during.
+    Inputs after the last phase are delivered by the next frame's first
+    Dispatch, so they're recorded as coming in before the next frame
+  Inputs are delivered as events on the Engine's EventBus, so games read
+  them the same way whether they're live or replayed. While replaying,
+  live inputs are dropped, and Engine::Update returns false once the
+  last recorded frame has run.
+  Inputs are stored with a hash of their type's name, since EventTypeIDs
+  depend on the order types are first used in. A replay delivers each
+  input as the registered type with that name, and refuses a recording
+  whose input sizes don't match the registered types. Event types must
+  be plain data. Time is frozen for the whole process, so
+  only one Engine should record or replay at a time.
+  */
+  /*****************************************/
+  class Recorder
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    Conversion constructor.
+
+    \param events
+    Event bus inputs are delivered on.
+    */
+    /*****************************************/
+    Recorder(EventBus *events);
+
+    /*****************************************/
+    /*!
+    \brief
+    Destructor. Stops recording or replaying.
+    */
+    /*****************************************/
+    ~Recorder();
+
+    /*****************************************/
+    /*!
+    \brief
+    Starts recording, from the next Engine::Update on.
+
+    \param path
+    File to record to.
+
+    \return
+    true if the file could be opened.
+    */
+    /*****************************************/
+    bool Record(const std::string &path);
+
+    /*****************************************/
+    /*!
+    \brief
+    Starts replaying a recording, from the next Engine::Update on.
+    Every input type in the recording must have been registered.
+
+    \param path
+    File to replay.
+
+    \return
+    true if the recording could be read.
+    */
+    /*****************************************/
+    bool Replay(const std::string &path);
+
+    /*****************************************/
+    /*!
+    \brief
+    Stops recording or replaying.
+    */
+    /*****************************************/
+    void Stop();
+
+    /*****************************************/
+    /*!
+    \brief
+    Determines if a session is being recorded.
+    */
+    /*****************************************/
+    bool IsRecording() const { return recording; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Determines if a recording is being replayed.
+    */
+    /*****************************************/
+    bool IsReplaying() const { return replaying; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Determines if a replay has run out of recorded frames.
+    */
+    /*****************************************/
+    bool IsFinished() const { return finished; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the number of frames recorded or replayed so far.
+    */
+    /*****************************************/
+    unsigned GetFrame() const { return frame; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Lets a type of input be replayed. Input registers its type, but a
+    replaying session may not have sent that input yet.
+
+    \tparam T
+    Type of the input.
+    */
+    /*****************************************/
+    template <typename T>
+    void Register()
+    {
+      EventTypeID id = EventBus::Type<T>::id;
+      if (id < BT_MAX_EVENT_TYPES)
+      {
+        emitters[id] = &EmitRecorded<T>;
+        sizes[id] = sizeof(T);
+        hashes[id] = TypeHash<T>();
+      }
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Sends an input from outside the engine (a key press, a network
+    message...). It is emitted on the EventBus, and recorded if a session
+    is being recorded. Dropped while replaying. Safe on any thread.
+
+    \tparam T
+    Type of the input. Must be plain data.
+
+    \param input
+    The input.
+    */
+    /*****************************************/
+    template <typename T>
+    void Input(const T &input)
+    {
+      Register<T>();
+      if (replaying) return;
+      if (recording) Store(EventBus::Type<T>::id, &input, sizeof(T));
+      events->Emit(input);
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Starts a frame. While replaying, freezes Time and emits the inputs
+    sent before the frame. Called by Engine::Update.
+
+    \return
+    false if a replay has run out of frames.
+    */
+    /*****************************************/
+    bool BeginFrame();
+
+    /*****************************************/
+    /*!
+    \brief
+    Records or replays the time the fixed step accumulates this frame.
+    Called by Engine::Update.
+
+    \param elapsed
+    Time since the last fixed step update in us.
+
+    \return
+    The time to accumulate in us.
+    */
+    /*****************************************/
+    uint64_t Elapsed(uint64_t elapsed);
+
+    /*****************************************/
+    /*!
+    \brief
+    Ends a phase. While replaying, emits the inputs sent during it, so
+    they're in the same Dispatch as when recorded. Called by
+    Engine::Update.
+
+    \param phase
+    Phase that ended.
+    */
+    /*****************************************/
+    void EndPhase(unsigned phase);
+
+    /*****************************************/
+    /*!
+    \brief
+    Ends a frame, writing it out while recording. Called by
+    Engine::Update.
+    */
+    /*****************************************/
+    void EndFrame();
+
+  private:
+    //! Phase of inputs sent between Engine updates
+    static const uint8_t PHASE_BEFORE = 0xFF;
+
+    //! Emits a recorded input as its type
+    typedef void (*Emitter)(EventBus &events, const char *data);
+
+    /*****************************************/
+    /*!
+    \brief
+    An input of a frame.
+    */
+    /*****************************************/
+    struct Recorded
+    {
+      uint64_t type; //!< Hash of the input type's name, see TypeHash
+      uint8_t phase; //!< Phase the input came in during
+      std::vector<char> data; //!< The input
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Everything one frame depended on.
+    */
+    /*****************************************/
+    struct Frame
+    {
+      uint64_t current; //!< Time::Current during the frame
+      uint64_t elapsed; //!< Time the fixed step accumulated in us
+      std::vector<Recorded> inputs; //!< Inputs in the order they came
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Emits a recorded input.
+
+    \tparam T
+    Type of the input.
+    */
+    /*****************************************/
+    template <typename T>
+    static void EmitRecorded(EventBus &events, const char *data)
+    {
+      // Recorded inputs are in their own heap blocks, so they're aligned
+      events.Emit(*reinterpret_cast<const T *>(data));
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Hashes a name with 64 bit FNV-1a.
+    */
+    /*****************************************/
+    static uint64_t HashName(const char *name);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets a hash of a type's name, the same in every build. Built without
+    RTTI, so the name comes from the function's own signature.
+
+    \tparam T
+    Type to hash.
+    */
+    /*****************************************/
+    template <typename T>
+    static uint64_t TypeHash()
+    {
+      #ifdef _MSC_VER
+      static const uint64_t hash = HashName(__FUNCSIG__);
+      #else
+      static const uint64_t hash = HashName(__PRETTY_FUNCTION__);
+      #endif
+      return hash;
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Finds the registered input type with a hash.
+
+    \return
+    The type's ID, BT_MAX_EVENT_TYPES if none is registered.
+    */
+    /*****************************************/
+    EventTypeID FindType(uint64_t hash) const;
+
+    /*****************************************/
+    /*!
+    \brief
+    Adds an input to the frame being recorded.
+    */
+    /*****************************************/
+    void Store(EventTypeID type, const void *data, unsigned size);
+
+    /*****************************************/
+    /*!
+    \brief
+    Emits the replayed frame's inputs from one phase.
+    */
+    /*****************************************/
+    void EmitPhase(uint8_t phase);
+
+    EventBus *events; //!< Event bus inputs are delivered on
+    Emitter emitters[BT_MAX_EVENT_TYPES]; //!< Input emitters by type
+    unsigned sizes[BT_MAX_EVENT_TYPES]; //!< Input sizes by type
+    uint64_t hashes[BT_MAX_EVENT_TYPES]; //!< Input type name hashes by type
+    bool recording; //!< Determines if a session is being recorded
+    bool replaying; //!< Determines if a recording is being replayed
+    bool finished; //!< Determines if a replay ran out of frames
+    bool inframe; //!< Determines if Engine::Update is running
+    uint8_t phase; //!< Phase running, PHASE_BEFORE between updates
+    unsigned frame; //!< Frames recorded or replayed
+    Frame current; //!< Frame being recorded
+    std::vector<Recorded> carried; //!< Inputs after the last phase
+    std::vector<Frame> frames; //!< Recording being replayed
+    std::ofstream file; //!< File being recorded to
+    #ifndef BT_NO_THREADS
+    std::mutex lock; //!< Guards current's inputs
+    #endif
+  };
+}
+
+#endif
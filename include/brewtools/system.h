@@ -16,6 +16,12 @@ Base class for systems.
 #ifndef __BT_SYSTEM_H_
 #define __BT_SYSTEM_H_
 
+#include <cstdint>
+#include <vector> // std::vector
+
+//! Max number of system types the Engine can hold (SysIDs start at 1)
+#define BT_MAX_SYSTEMS 64
+
 /*****************************************/
 /*!
 \brief
@@ -36,6 +42,46 @@ namespace BrewTools
   class ProtoSystem
   {
   public:
+    /*****************************************/
+    /*!
+    \brief
+    Phases of a frame, dispatched in this order by Engine::Update.
+    */
+    /*****************************************/
+    enum Phase
+    {
+      PHASE_INPUT,      //!< Gathering input and time
+      PHASE_PREUPDATE,  //!< Preparing for the simulation
+      PHASE_UPDATE,     //!< Simulation (FixedUpdate runs right before it)
+      PHASE_POSTUPDATE, //!< Reacting to the simulation
+      PHASE_RENDER,     //!< Drawing
+      PHASE_PRESENT,    //!< Presenting the frame and flushing output
+      PHASE_COUNT       //!< Number of phases
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    How often the Engine dispatches a system's PhaseUpdate.
+    */
+    /*****************************************/
+    enum UpdatePolicy
+    {
+      UPDATE_ALWAYS,    //!< Every frame (the default)
+      UPDATE_EVERY_N,   //!< Once every N frames
+      UPDATE_FREQUENCY, //!< N times per second of Time::Current
+      UPDATE_ON_WAKE    //!< Only after Engine::Wake
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Default constructor.
+    Systems start in PHASE_UPDATE with priority 0.
+    */
+    /*****************************************/
+    ProtoSystem();
+
     /*****************************************/
     /*!
     \brief
@@ -51,6 +97,54 @@ namespace BrewTools
     */
     /*****************************************/
     virtual void Update() = 0;
+
+    /*****************************************/
+    /*!
+    \brief
+    Advances the system's simulation by one fixed step.
+    Only called when the Engine has a fixed step set, zero or more times
+    per frame right before PHASE_UPDATE, for systems in that phase.
+    See Engine::SetFixedStep.
+    */
+    /*****************************************/
+    virtual void FixedUpdate() {}
+
+    /*****************************************/
+    /*!
+    \brief
+    Updates the system during one of its phases.
+    Defaults to calling Update. Systems in several phases can override
+    this to tell them apart.
+
+    \param phase
+    Phase being dispatched.
+    */
+    /*****************************************/
+    virtual void PhaseUpdate(Phase) { Update(); }
+
+    /*****************************************/
+    /*!
+    \brief
+    Saves the system's state before it is replaced by a reloaded module.
+    See Modules.
+
+    \param state
+    Buffer to append the state to.
+    */
+    /*****************************************/
+    virtual void Serialize(std::vector<char> &state) const { (void)state; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Restores the state saved by the system it replaces. Called right after
+    a reloaded module creates the system.
+
+    \param state
+    State written by the previous Serialize, empty if there was none.
+    */
+    /*****************************************/
+    virtual void Deserialize(const std::vector<char> &state) { (void)state; }
     
     /*****************************************/
     /*!
@@ -58,7 +152,203 @@ namespace BrewTools
     Gets the number of SysIDs
     */
     /*****************************************/
-    static SysID& GetSysIDCount();
+    static SysID GetSysIDCount();
+
+    /*****************************************/
+    /*!
+    \brief
+    Gives out the next SysID. Safe on any thread, since modules can be
+    loaded while workers run.
+    */
+    /*****************************************/
+    static SysID NextSysID();
+
+    /*****************************************/
+    /*!
+    \brief
+    Marks this system's accesses as declared.
+    A system that never declares its accesses is assumed to touch every
+    other system and is always updated in serial order, on the thread
+    that calls Engine::Update.
+    */
+    /*****************************************/
+    void DeclareAccess();
+
+    /*****************************************/
+    /*!
+    \brief
+    Declares that this system reads another system during Update.
+
+    \param id
+    ID of the system that is read.
+    */
+    /*****************************************/
+    void DeclareRead(SysID id);
+
+    /*****************************************/
+    /*!
+    \brief
+    Declares that this system modifies another system during Update.
+
+    \param id
+    ID of the system that is written.
+    */
+    /*****************************************/
+    void DeclareWrite(SysID id);
+
+    /*****************************************/
+    /*!
+    \brief
+    Forces this system to be updated on the thread that calls
+    Engine::Update (ie: it owns a graphics context).
+
+    \param mainonly
+    true to only update on the main thread.
+    */
+    /*****************************************/
+    void SetMainThreadOnly(bool mainonly = true) { mainthread = mainonly; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Determines if the system's accesses have been declared.
+    */
+    /*****************************************/
+    bool IsAccessDeclared() const { return declared; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Determines if the system must be updated on the main thread.
+    */
+    /*****************************************/
+    bool IsMainThreadOnly() const { return mainthread; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the systems read during Update as a bitmask of SysIDs.
+    */
+    /*****************************************/
+    uint64_t GetReadMask() const { return readmask; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the systems written during Update as a bitmask of SysIDs.
+    */
+    /*****************************************/
+    uint64_t GetWriteMask() const { return writemask; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Moves the system to a single phase.
+    Phases should only be changed from the main thread.
+
+    \param phase
+    Phase to update in.
+
+    \param priority
+    Order within the phase. Lower priorities update first, ties are
+    broken by SysID.
+    */
+    /*****************************************/
+    void SetPhase(Phase phase, int priority = 0);
+
+    /*****************************************/
+    /*!
+    \brief
+    Adds a phase the system also updates in.
+
+    \param phase
+    Phase to update in.
+
+    \param priority
+    Order within the phase. Lower priorities update first.
+    */
+    /*****************************************/
+    void AddPhase(Phase phase, int priority = 0);
+
+    /*****************************************/
+    /*!
+    \brief
+    Stops the system from updating in a phase.
+
+    \param phase
+    Phase to leave.
+    */
+    /*****************************************/
+    void RemovePhase(Phase phase);
+
+    /*****************************************/
+    /*!
+    \brief
+    Determines if the system updates in a phase.
+    */
+    /*****************************************/
+    bool InPhase(Phase phase) const { return phasemask & (1u << phase); }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the system's priority in a phase.
+    */
+    /*****************************************/
+    int GetPriority(Phase phase) const { return priorities[phase]; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Sets how often the system updates. Frames the system is idle in don't
+    touch it at all. Engine::Wake updates it in its next phase whatever
+    the policy. FixedUpdate is still dispatched every fixed step.
+    Policies should only be changed from the main thread.
+
+    \param policy
+    How often to update.
+
+    \param value
+    N for UPDATE_EVERY_N and UPDATE_FREQUENCY, ignored otherwise.
+    */
+    /*****************************************/
+    void SetUpdatePolicy(UpdatePolicy policy, unsigned value = 0);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets how often the system updates.
+    */
+    /*****************************************/
+    UpdatePolicy GetUpdatePolicy() const { return policy; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets N of the system's update policy, at least 1.
+    */
+    /*****************************************/
+    unsigned GetUpdateValue() const { return policyvalue; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets a counter bumped whenever any system changes its phases or
+    update policy.
+    Used by the Engine to know when to re-sort its phase lists.
+    */
+    /*****************************************/
+    static unsigned GetPhaseVersion();
+
+  private:
+    uint64_t readmask;  //!< Bit per SysID read during Update
+    uint64_t writemask; //!< Bit per SysID written during Update
+    bool declared;      //!< Determines if accesses have been declared
+    bool mainthread;    //!< Determines if Update must run on the main thread
+    unsigned phasemask; //!< Bit per Phase the system updates in
+    int priorities[PHASE_COUNT]; //!< Order within each phase
+    UpdatePolicy policy; //!< How often the system updates
+    unsigned policyvalue; //!< N of the update policy
   };
   
   /*****************************************/
@@ -100,6 +390,39 @@ namespace BrewTools
     {
       return id;
     }
+
+  protected:
+    /*****************************************/
+    /*!
+    \brief
+    Declares that this system reads another system during Update.
+
+    \tparam U
+    System that is read.
+    */
+    /*****************************************/
+    template<typename U>
+    void Reads()
+    {
+      DeclareRead(U::id);
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Declares that this system modifies another system during Update.
+
+    \tparam U
+    System that is written.
+    */
+    /*****************************************/
+    template<typename U>
+    void Writes()
+    {
+      DeclareWrite(U::id);
+    }
+
+  public:
     
     static const SysID id; //!< ID of the system
   };
@@ -114,7 +437,7 @@ namespace BrewTools
   */
   /*****************************************/
   template<typename T>
-  const SysID System<T>::id = ++ProtoSystem::GetSysIDCount();
+  const SysID System<T>::id = ProtoSystem::NextSysID();
 }
 
 #endif
@@ -18,7 +18,7 @@ Time management system.
 
 #include "brewtools/system.h"
 #include <cstdint>
-#ifdef _WIN32 //The following only exists in a Windows build
+#ifndef _3DS //The following doesn't exist in a 3DS build
 #include <chrono>
 #endif
 
@@ -68,6 +68,30 @@ namespace BrewTools
     */
     /*****************************************/
     static uint64_t Current();
+
+    /*****************************************/
+    /*!
+    \brief
+    Makes Current return a fixed time, so a recorded session sees the same
+    times when replayed. Used by Recorder.
+
+    \param time
+    Time in ms for Current to return, 0 to go back to the clock.
+    */
+    /*****************************************/
+    static void Freeze(uint64_t time);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the current time from a monotonic high resolution clock.
+    Only meaningful relative to other calls.
+    
+    \return
+    Current time in microseconds
+    */
+    /*****************************************/
+    static uint64_t Precise();
     
     /*****************************************/
     /*!
@@ -19,15 +19,135 @@ To avoid confusion, only use trace levels lower than 5
 #define __BT_TRACE_H_
 
 #include "brewtools/system.h" // System base class
+#include "brewtools/macros.h" // BT_NO_THREADS
+#include "brewtools/tracebinary.h" // TraceArg, TraceSignature
+#include "brewtools/traceline.h" // TraceLine, MAX_TRACE_LENGTH
 #include <string>  // std::string
 #include <sstream> // std::stringstream
 #include <fstream> // std::ofstream
+#include <vector>  // std::vector
+
+#ifndef BT_NO_THREADS
+#include <mutex>  // std::mutex
+#include <atomic> // std::atomic
+#include <thread> // std::thread
+#endif
 
 #ifdef _3DS //The following only exists in a 3DS build
 #include <3ds.h>
 #endif //_3DS
 
-#define MAX_TRACE_LENGTH 4096
+#ifndef BT_TRACE_HISTORY
+#define BT_TRACE_HISTORY 32 //!< Number of recent lines kept for GetRecent
+#endif
+
+#ifndef BT_TRACE_RING
+#define BT_TRACE_RING 4096 //!< Records in the async ring, a power of two
+#endif
+
+#ifndef BT_TRACE_RECORD
+#define BT_TRACE_RECORD 112 //!< Characters of a line held by an async record
+#endif
+
+#ifndef BT_TRACE_MAX_LEVEL
+//! Highest level BT_TRACE compiles in. Release builds can define it as 4
+//! to drop BrewTools' own levels, or lower
+#define BT_TRACE_MAX_LEVEL 0xFFFFFFFFu
+#endif
+
+/*****************************************/
+/*!
+\brief
+Traces a message through a Trace. The message is a << chain, formatted
+into a single line: BT_TRACE_TO(trace, 3, "Drew " << count << " shapes").
+The line is formatted into a TraceLine on the caller's stack, so built-in
+types and strings don't allocate.
+Messages above BT_TRACE_MAX_LEVEL compile to nothing. Messages above
+Trace::SetMaxPrintLevel cost one branch: the chain is never evaluated.
+
+\param trace
+Pointer to the Trace, may be nullptr.
+
+\param level
+Level of the message, a constant.
+*/
+/*****************************************/
+#define BT_TRACE_TO(trace, level, ...) \
+  do \
+  { \
+    if ((level) <= BT_TRACE_MAX_LEVEL) \
+    { \
+      BrewTools::Trace *bt_trace_ = (trace); \
+      if (bt_trace_ && bt_trace_->IsEnabled(level)) \
+      { \
+        BrewTools::TraceLine bt_line_; \
+        bt_line_ << __VA_ARGS__; \
+        bt_trace_->Write(level, bt_line_.GetText(), bt_line_.GetLength()); \
+      } \
+    } \
+  } while (0)
+
+/*****************************************/
+/*!
+\brief
+Traces a message through the current Engine's Trace, if it has one.
+Needs brewtools/distillery.h. See BT_TRACE_TO.
+
+\param level
+Level of the message, a constant.
+*/
+/*****************************************/
+#define BT_TRACE(level, ...) \
+  BT_TRACE_TO( \
+    BrewTools::Engine::Get()->GetSystemIfExists<BrewTools::Trace>(), \
+    level, __VA_ARGS__ \
+  )
+
+/*****************************************/
+/*!
+\brief
+Traces a message through a Trace, formatted later. The message is a
+format string literal with a "{}" for each argument:
+BT_TRACE_BIN_TO(trace, 3, "Drew {} shapes in {}ms", count, ms).
+While a binary log is open (see Trace::OpenBinary) only an ID for the
+call site, a timestamp and the arguments' bytes are stored, and the
+bttrace-decode tool formats them. Otherwise the message is formatted
+and traced as a line. Levels are filtered like BT_TRACE_TO.
+
+\param trace
+Pointer to the Trace, may be nullptr.
+
+\param level
+Level of the message, a constant.
+*/
+/*****************************************/
+#define BT_TRACE_BIN_TO(trace, level, ...) \
+  do \
+  { \
+    if ((level) <= BT_TRACE_MAX_LEVEL) \
+    { \
+      static BrewTools::TraceSite bt_site_(0); \
+      BrewTools::Trace *bt_trace_ = (trace); \
+      if (bt_trace_ && bt_trace_->IsEnabled(level)) \
+        bt_trace_->Binary(bt_site_, level, __VA_ARGS__); \
+    } \
+  } while (0)
+
+/*****************************************/
+/*!
+\brief
+Traces a message through the current Engine's Trace, formatted later.
+Needs brewtools/distillery.h. See BT_TRACE_BIN_TO.
+
+\param level
+Level of the message, a constant.
+*/
+/*****************************************/
+#define BT_TRACE_BIN(level, ...) \
+  BT_TRACE_BIN_TO( \
+    BrewTools::Engine::Get()->GetSystemIfExists<BrewTools::Trace>(), \
+    level, __VA_ARGS__ \
+  )
 
 /*****************************************/
 /*!
@@ -38,25 +158,29 @@ Brewtools namespace.
 namespace BrewTools
 {
   class Console; // Forward declaration
+  class TraceStream; // Forward declaration
+
+  //! Format ID of a BT_TRACE_BIN call site, 0 until it first traces
+  #ifndef BT_NO_THREADS
+  typedef std::atomic<unsigned> TraceSite;
+  #else
+  typedef unsigned TraceSite;
+  #endif
 
   /*****************************************/
   /*!
   \brief
   Trace system class.
   Used for printing to a console and file.
+  Safe on any thread, the level set by operator[] is per thread.
+  In async mode (see SetAsync) lines are handed to a writer thread instead
+  of being written by the caller.
+  In binary mode (see OpenBinary) everything goes to a binary log instead,
+  and BT_TRACE_BIN messages are stored without being formatted.
   */
   /*****************************************/
   class Trace : public System<Trace>
   {
-  private:
-    /*****************************************/
-    /*!
-    \brief
-    Prints the stream to the currently selected console
-    */
-    /*****************************************/
-    void PrintStream();
-
   public:
     /*****************************************/
     /*!
@@ -117,15 +241,36 @@ namespace BrewTools
     \brief
     Outputs a string to the console and file (if one is open).
     Should be used with operator[]: Trace[#] << msg;
+    Anything chained after it (Trace[#] << msg << value) goes on the same
+    line, which is traced once the statement ends.
 
     \param output
     What to output into the trace.
     
     \return
-    Reference to the Trace's stream.
+    The line being traced.
     */
     /*****************************************/
-    std::stringstream &operator<<(std::string output);
+    TraceStream operator<<(const std::string &output);
+
+    /*****************************************/
+    /*!
+    \brief
+    Outputs a line to the console and file (if one is open), or to the
+    async ring or binary log. Doesn't allocate once the history lines and
+    buffers have grown. Used by BT_TRACE.
+
+    \param level
+    Level of the line.
+
+    \param text
+    The line.
+
+    \param length
+    Characters in the line.
+    */
+    /*****************************************/
+    void Write(unsigned level, const char *text, size_t length);
     
     /*****************************************/
     /*!
@@ -181,7 +326,243 @@ namespace BrewTools
     /*****************************************/
     void SetMaxPrintLevel(unsigned ml = -1) { max_print_level = ml; }
 
+    /*****************************************/
+    /*!
+    \brief
+    Determines if messages of a level are printed. Used by BT_TRACE to
+    skip formatting messages that would be thrown away.
+
+    \param level
+    Level to check.
+    */
+    /*****************************************/
+    bool IsEnabled(unsigned level) const { return level <= max_print_level; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the last BT_TRACE_HISTORY lines that were printed.
+
+    \param lines
+    Filled with the lines, oldest first.
+    */
+    /*****************************************/
+    void GetRecent(std::vector<std::string> &lines) const;
+
+    /*****************************************/
+    /*!
+    \brief
+    Turns async mode on or off. In async mode each traced line is copied
+    into a lock-free ring and the caller returns; a chain of operator<<
+    is pushed as one line when its statement ends. A writer thread writes
+    the lines to the console and file in batches, flushing once per
+    batch. Lines
+    longer than the ring are cut short. A full ring makes callers wait
+    for the writer. Turning it off writes every pending line first.
+    Should only be called while no other thread is tracing.
+
+    \param enable
+    true to write from the writer thread.
+
+    \return
+    true if the mode was set, false if threads are disabled.
+    */
+    /*****************************************/
+    bool SetAsync(bool enable);
+
+    /*****************************************/
+    /*!
+    \brief
+    Determines if Trace is in async mode.
+    */
+    /*****************************************/
+    bool IsAsync() const;
+
+    /*****************************************/
+    /*!
+    \brief
+    Waits until every line traced so far has been written. Does nothing
+    outside of async mode.
+    */
+    /*****************************************/
+    void Flush();
+
+    /*****************************************/
+    /*!
+    \brief
+    Starts binary mode, writing everything traced to a binary log until
+    CloseBinary. The console and text file get nothing meanwhile, and
+    async mode is turned off. Records are buffered and written out every
+    BT_TRACE_BINARY_BUFFER bytes and every Update. The log is read with
+    bttrace-decode. Should only be called while no other thread is
+    tracing.
+
+    \param path
+    Path of the binary log.
+
+    \return
+    true if the log could be opened.
+    */
+    /*****************************************/
+    bool OpenBinary(const std::string &path);
+
+    /*****************************************/
+    /*!
+    \brief
+    Writes out the rest of the binary log and leaves binary mode.
+    */
+    /*****************************************/
+    void CloseBinary();
+
+    /*****************************************/
+    /*!
+    \brief
+    Determines if Trace is in binary mode.
+    */
+    /*****************************************/
+    bool IsBinary() const;
+
+    /*****************************************/
+    /*!
+    \brief
+    Traces a message of BT_TRACE_BIN. Should be used through the macro.
+
+    \param site
+    Format ID of the call site, set the first time it traces.
+
+    \param level
+    Level of the message.
+
+    \param format
+    Format string with a "{}" for each argument.
+
+    \param args
+    Arguments of the message.
+    */
+    /*****************************************/
+    template <typename... Args>
+    void Binary(TraceSite &site, unsigned level, const char *format,
+      const Args &... args)
+    {
+      unsigned id = site;
+      if (!id)
+        id = RegisterFormat(site, level, format,
+          TraceSignature<typename std::decay<Args>::type...>::value);
+      {
+        #ifndef BT_NO_THREADS
+        std::lock_guard<std::mutex> guard(lock);
+        #endif
+        if (BeginMessage(id))
+        {
+          int expand[] = { 0, (TraceArg<typename std::decay<Args>::type>::
+            Put(binary, args), 0)... };
+          (void)expand;
+          EndRecord();
+          return;
+        }
+      }
+      TraceLine line;
+      Format(line, format, args...);
+      Write(level, line.GetText(), line.GetLength());
+    }
+
   private:
+    /*****************************************/
+    /*!
+    \brief
+    Formats a BT_TRACE_BIN message as text, like bttrace-decode does.
+
+    \param out
+    Stream to format into.
+
+    \param format
+    Rest of the format string.
+
+    \param value
+    Argument for the next "{}".
+
+    \param rest
+    Arguments after it.
+    */
+    /*****************************************/
+    template <typename T, typename... Rest>
+    static void Format(TraceLine &out, const char *format,
+      const T &value, const Rest &... rest)
+    {
+      format = FormatNext(out, format);
+      if (!format) return;
+      TraceArg<typename std::decay<T>::type>::Print(out, value);
+      Format(out, format, rest...);
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Formats the end of a BT_TRACE_BIN message.
+    */
+    /*****************************************/
+    static void Format(TraceLine &out, const char *format)
+    {
+      out << format;
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Formats a format string up to its next "{}".
+
+    \return
+    The format string after the "{}", nullptr if there was none.
+    */
+    /*****************************************/
+    static const char *FormatNext(TraceLine &out, const char *format);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gives a BT_TRACE_BIN call site its format ID. IDs are shared by every
+    Trace in the process.
+
+    \param site
+    Format ID of the call site, set unless another thread set it first.
+
+    \return
+    The format ID.
+    */
+    /*****************************************/
+    static unsigned RegisterFormat(TraceSite &site, unsigned level,
+      const char *format, const char *signature);
+
+    /*****************************************/
+    /*!
+    \brief
+    Starts a message record in the binary log, defining its format first
+    if the log hasn't seen it yet. Must be called with the lock held.
+
+    \return
+    false if Trace isn't in binary mode.
+    */
+    /*****************************************/
+    bool BeginMessage(unsigned id);
+
+    /*****************************************/
+    /*!
+    \brief
+    Ends a record, writing the buffer out once it's big enough. Must be
+    called with the lock held.
+    */
+    /*****************************************/
+    void EndRecord();
+
+    /*****************************************/
+    /*!
+    \brief
+    Writes the buffered records to the binary log. Must be called with
+    the lock held.
+    */
+    /*****************************************/
+    void WriteBinary();
+
     /*****************************************/
     /*!
     \brief
@@ -189,15 +570,171 @@ namespace BrewTools
     */
     /*****************************************/
     void CloseFile();
+
+    /*****************************************/
+    /*!
+    \brief
+    Adds a line to the history.
+
+    \param level
+    Level of the line.
+
+    \param text
+    The line.
+
+    \param length
+    Characters in the line.
+    */
+    /*****************************************/
+    void Remember(unsigned level, const char *text, size_t length);
+
+    #ifndef BT_NO_THREADS
+    /*****************************************/
+    /*!
+    \brief
+    Part of a line in the async ring.
+    */
+    /*****************************************/
+    struct Record
+    {
+      //! Position the record may be written at, one past when it's full
+      std::atomic<uint64_t> sequence;
+      unsigned level; //!< Level of the line
+      unsigned length; //!< Characters in text
+      bool more; //!< Determines if the line goes on in the next record
+      char text[BT_TRACE_RECORD]; //!< Part of the line
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Copies a line into the async ring.
+
+    \param level
+    Level of the line.
+
+    \param text
+    The line.
+
+    \param length
+    Characters in the line.
+    */
+    /*****************************************/
+    void Push(unsigned level, const char *text, size_t length);
+
+    /*****************************************/
+    /*!
+    \brief
+    Writes lines from the async ring until async mode is turned off.
+    */
+    /*****************************************/
+    void WriterLoop();
+    #endif
     
     std::string m_path; //!< Path of file
     std::ofstream m_os; //!< File out stream
-    unsigned   m_level; //!< Current level of trace
     Console *m_console; //!< Currently selected console
     bool    m_printing; //!< Determines if console is being printed to
-    std::stringstream stream; //!< Buffer for strings
     unsigned max_print_level; //!< Max level of trace that can be printed
-    std::stringstream garbage; //!< Garbage bin for unprintable streams
+    std::string history[BT_TRACE_HISTORY]; //!< Ring of recent lines
+    unsigned historynext; //!< Index the next line goes to in history
+    unsigned historycount; //!< Number of lines in history
+    std::ofstream binaryfile; //!< Binary log, open in binary mode
+    std::vector<char> binary; //!< Records not written to the log yet
+    std::vector<bool> defined; //!< Format IDs the log has defined
+    #ifndef BT_NO_THREADS
+    mutable std::mutex lock; //!< Guards the outputs and history
+    Record *ring; //!< Lines waiting for the writer, nullptr if not async
+    std::atomic<uint64_t> tail; //!< Position of the next record pushed
+    std::atomic<uint64_t> written; //!< Records written by the writer
+    std::atomic<bool> running; //!< Determines if the writer should go on
+    std::thread writer; //!< Writes the lines in async mode
+    #endif
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Line traced with Trace::operator<<. Everything chained onto it is
+  formatted into a TraceLine, and the whole line is traced when the
+  statement ends. Each statement has its own, so threads tracing at the
+  same time never share one.
+  */
+  /*****************************************/
+  class TraceStream
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    Conversion constructor.
+
+    \param trace
+    Trace the line goes to, nullptr to throw it away.
+
+    \param level
+    Level of the line.
+    */
+    /*****************************************/
+    TraceStream(Trace *trace, unsigned level) : trace(trace), level(level) {}
+
+    /*****************************************/
+    /*!
+    \brief
+    Move constructor. Only the new stream traces the line.
+    */
+    /*****************************************/
+    TraceStream(TraceStream &&other)
+      : trace(other.trace), level(other.level), line(other.line)
+    {
+      other.trace = nullptr;
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Destructor. Traces the line.
+    */
+    /*****************************************/
+    ~TraceStream()
+    {
+      if (trace) trace->Write(level, line.GetText(), line.GetLength());
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Adds a value to the line, formatted like TraceLine does. Nothing is
+    formatted if the line is thrown away.
+    */
+    /*****************************************/
+    template <typename T>
+    TraceStream &operator<<(const T &value)
+    {
+      if (trace) line << value;
+      return *this;
+    }
+
+    //! Applies std::endl, std::ends or std::flush
+    TraceStream &operator<<(std::ostream &(*manipulator)(std::ostream &))
+    {
+      if (trace) line << manipulator;
+      return *this;
+    }
+
+    //! Applies std::dec, std::hex or std::oct
+    TraceStream &operator<<(std::ios_base &(*manipulator)(std::ios_base &))
+    {
+      if (trace) line << manipulator;
+      return *this;
+    }
+
+  private:
+    TraceStream &operator=(const TraceStream &) = delete;
+
+    Trace *trace; //!< Trace the line goes to, nullptr to throw it away
+    unsigned level; //!< Level of the line
+    TraceLine line; //!< The line
   };
 }
 
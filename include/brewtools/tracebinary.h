@@ -0,0 +1,351 @@
+/******************************************************************************/
+/*!
+\file tracebinary.h
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Layout of binary trace logs and how arguments are stored in them.
+Shared by Trace and the bttrace-decode tool.
+*/
+/******************************************************************************/
+
+#ifndef __BT_TRACEBINARY_H_
+#define __BT_TRACEBINARY_H_
+
+#include <cstdint>     // uint32_t, uint64_t, uintptr_t
+#include <ostream>     // std::ostream
+#include <string>      // std::string
+#include <type_traits> // std::is_integral, std::conditional
+#include <vector>      // std::vector
+
+#ifndef BT_TRACE_BINARY_BUFFER
+//! Bytes of binary trace records buffered before they're written out
+#define BT_TRACE_BINARY_BUFFER 65536
+#endif
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  /*****************************************/
+  /*!
+  \brief
+  Layout of a binary trace log. Values are in the byte order of the
+  machine that wrote the log.
+  The log starts with a header:
+  - MAGIC
+  - uint32_t ORDER_MARK, so readers can tell the byte order apart
+  - uint64_t Time::Current when the log was opened, in ms
+  - uint64_t Time::Precise when the log was opened, in us
+  Then come records, each starting with a uint8_t Record:
+  - RECORD_FORMAT: uint32_t format ID, uint32_t level, uint32_t length
+    and characters of the signature, uint32_t length and characters of
+    the format string. Written before the first message using the ID.
+  - RECORD_MESSAGE: uint32_t format ID, uint64_t Time::Precise in us,
+    then each argument as described by the signature.
+  - RECORD_TEXT: uint32_t level, uint64_t Time::Precise in us, uint32_t
+    length and characters of a line traced with operator<<.
+  Format strings hold a "{}" for each argument. A signature holds a
+  character for each argument:
+  - 'b' bool, 1 byte
+  - 'c' char, 1 byte
+  - 'i' / 'u' signed / unsigned integers up to 32 bits, 4 bytes
+  - 'l' / 'L' signed / unsigned 64 bit integers, 8 bytes
+  - 'f' float, 4 bytes
+  - 'd' double, 8 bytes
+  - 'p' pointer, 8 bytes
+  - 's' string, uint32_t length and characters
+  */
+  /*****************************************/
+  namespace TraceBinary
+  {
+    //! First bytes of a binary trace log, the last one is the version
+    static const char MAGIC[8] = { 'B', 'T', 'T', 'R', 'A', 'C', 'E', 1 };
+
+    //! Written as a uint32_t, reads differently in the other byte order
+    static const uint32_t ORDER_MARK = 0x01020304;
+
+    /*****************************************/
+    /*!
+    \brief
+    Kinds of records in a binary trace log.
+    */
+    /*****************************************/
+    enum Record
+    {
+      RECORD_FORMAT = 1, //!< Defines a format ID
+      RECORD_MESSAGE,    //!< A message traced with BT_TRACE_BIN
+      RECORD_TEXT        //!< A line traced with operator<<
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Appends a value's bytes to a buffer.
+    */
+    /*****************************************/
+    template <typename T>
+    void Put(std::vector<char> &out, const T &value)
+    {
+      const char *bytes = reinterpret_cast<const char *>(&value);
+      out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Appends a string to a buffer, its length first.
+    */
+    /*****************************************/
+    inline void PutString(std::vector<char> &out, const char *text,
+      size_t length)
+    {
+      Put(out, uint32_t(length));
+      out.insert(out.end(), text, text + length);
+    }
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Stores a type of argument in binary trace logs, and prints it the way
+  bttrace-decode does, to a std::ostream or a TraceLine. Only the
+  specializations exist: tracing any other type doesn't compile.
+
+  \tparam T
+  Type of the argument, without references or const.
+  */
+  /*****************************************/
+  template <typename T, bool Integral = std::is_integral<T>::value>
+  struct TraceArg;
+
+  /*****************************************/
+  /*!
+  \brief
+  Stores integers in 4 or 8 bytes, keeping their sign.
+  */
+  /*****************************************/
+  template <typename T>
+  struct TraceArg<T, true>
+  {
+    static const bool small = sizeof(T) <= 4; //!< Fits in 4 bytes
+    static const bool sign = std::is_signed<T>::value; //!< Is signed
+    static const char code = small ? (sign ? 'i' : 'u') : (sign ? 'l' : 'L');
+    //! Type the integer is stored as
+    typedef typename std::conditional<small,
+      typename std::conditional<sign, int32_t, uint32_t>::type,
+      typename std::conditional<sign, int64_t, uint64_t>::type
+    >::type Stored;
+
+    //! Stores the argument
+    static void Put(std::vector<char> &out, T value)
+    {
+      TraceBinary::Put(out, Stored(value));
+    }
+
+    //! Prints the argument
+    template <typename Out>
+    static void Print(Out &out, T value) { out << Stored(value); }
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Stores bools in a byte, printed as true or false.
+  */
+  /*****************************************/
+  template <>
+  struct TraceArg<bool, true>
+  {
+    static const char code = 'b';
+
+    //! Stores the argument
+    static void Put(std::vector<char> &out, bool value)
+    {
+      TraceBinary::Put(out, uint8_t(value));
+    }
+
+    //! Prints the argument
+    template <typename Out>
+    static void Print(Out &out, bool value)
+    {
+      out << (value ? "true" : "false");
+    }
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Stores chars in a byte, printed as characters.
+  */
+  /*****************************************/
+  template <>
+  struct TraceArg<char, true>
+  {
+    static const char code = 'c';
+
+    //! Stores the argument
+    static void Put(std::vector<char> &out, char value)
+    {
+      out.push_back(value);
+    }
+
+    //! Prints the argument
+    template <typename Out>
+    static void Print(Out &out, char value) { out << value; }
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Stores floats as they are.
+  */
+  /*****************************************/
+  template <>
+  struct TraceArg<float, false>
+  {
+    static const char code = 'f';
+
+    //! Stores the argument
+    static void Put(std::vector<char> &out, float value)
+    {
+      TraceBinary::Put(out, value);
+    }
+
+    //! Prints the argument
+    template <typename Out>
+    static void Print(Out &out, float value) { out << value; }
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Stores doubles as they are.
+  */
+  /*****************************************/
+  template <>
+  struct TraceArg<double, false>
+  {
+    static const char code = 'd';
+
+    //! Stores the argument
+    static void Put(std::vector<char> &out, double value)
+    {
+      TraceBinary::Put(out, value);
+    }
+
+    //! Prints the argument
+    template <typename Out>
+    static void Print(Out &out, double value) { out << value; }
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Stores C strings' characters. nullptr is stored as an empty string.
+  */
+  /*****************************************/
+  template <>
+  struct TraceArg<const char *, false>
+  {
+    static const char code = 's';
+
+    //! Stores the argument
+    static void Put(std::vector<char> &out, const char *value)
+    {
+      if (!value) value = "";
+      TraceBinary::PutString(out, value, std::char_traits<char>::length(value));
+    }
+
+    //! Prints the argument
+    template <typename Out>
+    static void Print(Out &out, const char *value)
+    {
+      if (value) out << value;
+    }
+  };
+
+  //! Stores C strings' characters
+  template <>
+  struct TraceArg<char *, false> : TraceArg<const char *, false> {};
+
+  /*****************************************/
+  /*!
+  \brief
+  Stores strings' characters.
+  */
+  /*****************************************/
+  template <>
+  struct TraceArg<std::string, false>
+  {
+    static const char code = 's';
+
+    //! Stores the argument
+    static void Put(std::vector<char> &out, const std::string &value)
+    {
+      TraceBinary::PutString(out, value.data(), value.size());
+    }
+
+    //! Prints the argument
+    template <typename Out>
+    static void Print(Out &out, const std::string &value)
+    {
+      out << value;
+    }
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Stores pointers as addresses, printed in hex.
+  */
+  /*****************************************/
+  template <typename T>
+  struct TraceArg<T *, false>
+  {
+    static const char code = 'p';
+
+    //! Stores the argument
+    static void Put(std::vector<char> &out, const T *value)
+    {
+      TraceBinary::Put(out, uint64_t(uintptr_t(value)));
+    }
+
+    //! Prints the argument
+    template <typename Out>
+    static void Print(Out &out, const T *value)
+    {
+      out << "0x" << std::hex << uint64_t(uintptr_t(value)) << std::dec;
+    }
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Signature of a list of argument types, a character for each.
+
+  \tparam Args
+  Types of the arguments, without references or const.
+  */
+  /*****************************************/
+  template <typename... Args>
+  struct TraceSignature
+  {
+    static const char value[sizeof...(Args) + 1]; //!< The signature
+  };
+
+  template <typename... Args>
+  const char TraceSignature<Args...>::value[sizeof...(Args) + 1] =
+    { TraceArg<Args>::code..., 0 };
+}
+
+#endif
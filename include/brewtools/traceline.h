@@ -0,0 +1,254 @@
+/******************************************************************************/
+/*!
+\file traceline.h
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Fixed size buffer trace lines are formatted into.
+*/
+/******************************************************************************/
+
+#ifndef __BT_TRACELINE_H_
+#define __BT_TRACELINE_H_
+
+#include <cstddef> // size_t
+#include <ios>     // std::ios_base
+#include <ostream> // std::ostream
+#include <sstream> // std::stringstream
+#include <string>  // std::string
+#include <type_traits> // std::make_unsigned
+
+#ifndef MAX_TRACE_LENGTH
+#define MAX_TRACE_LENGTH 4096 //!< Longest trace line, including the null
+#endif
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  /*****************************************/
+  /*!
+  \brief
+  A trace line formatted into a fixed buffer, so formatting doesn't touch
+  the heap. BT_TRACE keeps one on the caller's stack.
+  Formats like a std::stringstream with default settings: integers in
+  decimal (or std::hex / std::oct), floats like "%g", chars as characters,
+  std::endl as a newline. Other types go through a std::stringstream.
+  Lines longer than MAX_TRACE_LENGTH - 1 are cut short.
+  */
+  /*****************************************/
+  class TraceLine
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    Default constructor. The line starts empty.
+    */
+    /*****************************************/
+    TraceLine() : length(0), base(10) { text[0] = 0; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the line, null terminated.
+    */
+    /*****************************************/
+    const char *GetText() const { return text; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the number of characters in the line.
+    */
+    /*****************************************/
+    size_t GetLength() const { return length; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Empties the line and goes back to decimal.
+    */
+    /*****************************************/
+    void Clear()
+    {
+      length = 0;
+      base = 10;
+      text[0] = 0;
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Adds characters to the line, as many as fit.
+
+    \param characters
+    Characters to add.
+
+    \param count
+    Number of characters.
+
+    \return
+    Reference to the line.
+    */
+    /*****************************************/
+    TraceLine &Append(const char *characters, size_t count);
+
+    //! Adds a C string, nothing if it's nullptr
+    TraceLine &operator<<(const char *value)
+    {
+      return value ? Append(value, std::char_traits<char>::length(value)) :
+        *this;
+    }
+
+    //! Adds a C string, nothing if it's nullptr
+    TraceLine &operator<<(char *value)
+    {
+      return operator<<(static_cast<const char *>(value));
+    }
+
+    //! Adds a string
+    TraceLine &operator<<(const std::string &value)
+    {
+      return Append(value.data(), value.size());
+    }
+
+    //! Adds a character
+    TraceLine &operator<<(char value) { return Append(&value, 1); }
+
+    //! Adds a character
+    TraceLine &operator<<(signed char value) { return operator<<(char(value)); }
+
+    //! Adds a character
+    TraceLine &operator<<(unsigned char value)
+    {
+      return operator<<(char(value));
+    }
+
+    //! Adds a bool as 1 or 0
+    TraceLine &operator<<(bool value) { return Unsigned(value); }
+
+    //! Adds an integer
+    TraceLine &operator<<(short value) { return Signed(value); }
+
+    //! Adds an integer
+    TraceLine &operator<<(unsigned short value) { return Unsigned(value); }
+
+    //! Adds an integer
+    TraceLine &operator<<(int value) { return Signed(value); }
+
+    //! Adds an integer
+    TraceLine &operator<<(unsigned value) { return Unsigned(value); }
+
+    //! Adds an integer
+    TraceLine &operator<<(long value) { return Signed(value); }
+
+    //! Adds an integer
+    TraceLine &operator<<(unsigned long value) { return Unsigned(value); }
+
+    //! Adds an integer
+    TraceLine &operator<<(long long value) { return Signed(value); }
+
+    //! Adds an integer
+    TraceLine &operator<<(unsigned long long value) { return Unsigned(value); }
+
+    //! Adds a float
+    TraceLine &operator<<(float value) { return Float(value); }
+
+    //! Adds a float
+    TraceLine &operator<<(double value) { return Float(value); }
+
+    //! Adds a float
+    TraceLine &operator<<(long double value) { return Float(double(value)); }
+
+    //! Adds an address in hex
+    TraceLine &operator<<(const void *value);
+
+    /*****************************************/
+    /*!
+    \brief
+    Applies std::endl, std::ends or std::flush. std::endl adds a newline,
+    the others do nothing.
+    */
+    /*****************************************/
+    TraceLine &operator<<(std::ostream &(*manipulator)(std::ostream &));
+
+    /*****************************************/
+    /*!
+    \brief
+    Applies std::dec, std::hex or std::oct to the integers after it.
+    Other manipulators do nothing.
+    */
+    /*****************************************/
+    TraceLine &operator<<(std::ios_base &(*manipulator)(std::ios_base &));
+
+    /*****************************************/
+    /*!
+    \brief
+    Adds any other type that can be written to a std::ostream. Uses a
+    std::stringstream, so it allocates.
+    */
+    /*****************************************/
+    template <typename T>
+    TraceLine &operator<<(const T &value)
+    {
+      std::stringstream formatted;
+      formatted << value;
+      return operator<<(formatted.str());
+    }
+
+  private:
+    /*****************************************/
+    /*!
+    \brief
+    Adds a signed integer. Outside of decimal, negative integers are
+    added as their unsigned bits, like streams do.
+    */
+    /*****************************************/
+    template <typename T>
+    TraceLine &Signed(T value)
+    {
+      typedef typename std::make_unsigned<T>::type Bits;
+      if (value < 0 && base == 10)
+        return Unsigned(Bits(0 - Bits(value)), true);
+      return Unsigned(Bits(value));
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Adds an unsigned integer in the current base.
+
+    \param value
+    The integer.
+
+    \param negative
+    true to add a minus sign first.
+    */
+    /*****************************************/
+    TraceLine &Unsigned(unsigned long long value, bool negative = false);
+
+    /*****************************************/
+    /*!
+    \brief
+    Adds a float like "%g".
+    */
+    /*****************************************/
+    TraceLine &Float(double value);
+
+    char text[MAX_TRACE_LENGTH]; //!< The line, null terminated
+    size_t length; //!< Characters in text
+    unsigned base; //!< Base integers are added in
+  };
+}
+
+#endif
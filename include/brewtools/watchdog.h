@@ -0,0 +1,174 @@
+/******************************************************************************/
+/*!
+\file watchdog.h
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Frame budget watchdog writing hitch reports.
+*/
+/******************************************************************************/
+
+#ifndef __BT_WATCHDOG_H_
+#define __BT_WATCHDOG_H_
+
+#include "brewtools/system.h" // SysID, BT_MAX_SYSTEMS
+#include <cstdint> // uint64_t, uint32_t
+#include <string>  // std::string
+
+#ifndef BT_WATCHDOG_FRAMES
+#define BT_WATCHDOG_FRAMES 16 //!< Frames of history in a hitch report
+#endif
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  class Engine; // Forward declaration
+
+  /*****************************************/
+  /*!
+  \brief
+  Compares each frame against a time budget and writes a hitch report
+  when one runs over.
+  A frame's time is measured from the end of one Engine::Update to the
+  end of the next, so it covers game code outside the Engine too.
+  The report holds the last BT_WATCHDOG_FRAMES frames of per-system
+  timings (needs the profiler enabled), per-system allocations (needs
+  BT_TRACK_ALLOCATIONS) and the last Trace lines.
+  After a report, hitches aren't reported again until the history has
+  been refilled, so a run of slow frames writes one file.
+  */
+  /*****************************************/
+  class Watchdog
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    Conversion constructor. The watchdog starts disabled.
+
+    \param engine
+    Engine being watched.
+    */
+    /*****************************************/
+    Watchdog(Engine *engine);
+
+    /*****************************************/
+    /*!
+    \brief
+    Sets the frame budget.
+
+    \param us
+    Longest a frame may take in microseconds. 0 disables the watchdog.
+    */
+    /*****************************************/
+    void SetBudget(uint64_t us);
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the frame budget in microseconds, 0 if disabled.
+    */
+    /*****************************************/
+    uint64_t GetBudget() const { return budget; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Determines if the watchdog is enabled.
+    */
+    /*****************************************/
+    bool IsEnabled() const { return budget != 0; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Sets where reports are written. Each report goes to
+    "<prefix><frame>.txt".
+
+    \param prefix
+    Path prefix of the reports. Defaults to "hitch-".
+    */
+    /*****************************************/
+    void SetReportPath(const std::string &prefix) { path = prefix; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the number of frames that went over budget.
+    */
+    /*****************************************/
+    unsigned GetHitchCount() const { return hitches; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the path of the last report written, empty if there was none.
+    */
+    /*****************************************/
+    const std::string &GetLastReport() const { return lastreport; }
+
+    /*****************************************/
+    /*!
+    \brief
+    Records the frame and writes a report if it went over budget.
+    Called by Engine::Update once the frame's statistics are in.
+
+    \param update
+    Microseconds Engine::Update took.
+    */
+    /*****************************************/
+    void EndFrame(uint64_t update);
+
+  private:
+    /*****************************************/
+    /*!
+    \brief
+    Statistics of one frame.
+    */
+    /*****************************************/
+    struct Frame
+    {
+      uint64_t number; //!< Frame number
+      uint32_t total; //!< Time since the previous frame in us
+      uint32_t update; //!< Time spent in Engine::Update in us
+      uint32_t times[BT_MAX_SYSTEMS]; //!< Update time of each system in us
+      uint32_t allocs[BT_MAX_SYSTEMS]; //!< Allocations of each system
+    };
+
+    /*****************************************/
+    /*!
+    \brief
+    Writes the history to a new report file.
+
+    \param hitch
+    The frame that went over budget.
+    */
+    /*****************************************/
+    void Report(const Frame &hitch);
+
+    Engine *engine; //!< Engine being watched
+    Frame frames[BT_WATCHDOG_FRAMES]; //!< Ring of the last frames
+    unsigned next; //!< Index the next frame goes to
+    unsigned count; //!< Number of frames in the ring
+    uint64_t budget; //!< Longest a frame may take in us, 0 if disabled
+    uint64_t number; //!< Frames recorded since enabled
+    uint64_t lastend; //!< Time the last frame ended in us
+    uint64_t quiet; //!< Frame number before which hitches aren't reported
+    unsigned hitches; //!< Frames that went over budget
+    unsigned skipped; //!< Hitches not reported since the last report
+    std::string path; //!< Prefix of report paths
+    std::string lastreport; //!< Path of the last report
+  };
+}
+
+#endif
@@ -0,0 +1,172 @@
+/******************************************************************************/
+/*!
+\file zones.h
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Scoped profiling zones exported as Chrome trace-event JSON.
+*/
+/******************************************************************************/
+
+#ifndef __BT_ZONES_H_
+#define __BT_ZONES_H_
+
+#include <string> // std::string
+
+#ifndef BT_ZONE_EVENTS
+//! Events each thread can buffer between flushes. Must be a power of 2
+#define BT_ZONE_EVENTS 0x4000
+#endif
+
+#ifdef BT_ZONES
+#define BT_ZONE_CAT2(a, b) a##b //!< Pastes two tokens together
+#define BT_ZONE_CAT(a, b) BT_ZONE_CAT2(a, b) //!< Expands then pastes
+/*****************************************/
+/*!
+\brief
+Times the rest of the enclosing scope as a zone on the timeline.
+Compiles to nothing unless BT_ZONES is defined.
+Name must be a string literal.
+*/
+/*****************************************/
+#define BT_ZONE(name) \
+  BrewTools::Zone BT_ZONE_CAT(btzone, __LINE__)(name)
+#else
+#define BT_ZONE(name)
+#endif
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  /*****************************************/
+  /*!
+  \brief
+  Collects zone events and writes them out.
+  Each thread records into its own ring buffer without locking. Flush
+  moves everything recorded so far into the file opened by Start, which
+  can be opened in chrome://tracing or ui.perfetto.dev.
+  A zone is only begun if its thread's buffer has room for its end, so
+  full buffers drop whole zones. A thread's buffer is freed once it exits
+  and its events are written, and its thread number is reused.
+  Engine::Update flushes once per frame while BT_ZONES is defined.
+  */
+  /*****************************************/
+  class Zones
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    Starts writing zones to a file, closing any previous one.
+
+    \param path
+    Path of the JSON file to write.
+
+    \return
+    true if the file was opened.
+    */
+    /*****************************************/
+    static bool Start(std::string path);
+
+    /*****************************************/
+    /*!
+    \brief
+    Flushes remaining events and closes the file.
+    */
+    /*****************************************/
+    static void Stop();
+
+    /*****************************************/
+    /*!
+    \brief
+    Writes every buffered event to the file. Events recorded while no file
+    is open are dropped. Should only be called from one thread at a time.
+    */
+    /*****************************************/
+    static void Flush();
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets the number of events dropped because a thread's buffer was full.
+    */
+    /*****************************************/
+    static unsigned GetDropped();
+
+    /*****************************************/
+    /*!
+    \brief
+    Records the start of a zone on the calling thread.
+
+    \param name
+    Name of the zone. Must outlive the flush.
+
+    \return
+    File session the zone was begun in, to pass to End. 0 if the zone was
+    dropped.
+    */
+    /*****************************************/
+    static unsigned Begin(const char *name);
+
+    /*****************************************/
+    /*!
+    \brief
+    Records the end of a zone on the calling thread. Never dropped if its
+    begin was recorded in the file still being written.
+
+    \param name
+    Name of the zone. Must outlive the flush.
+
+    \param session
+    Returned by Begin.
+    */
+    /*****************************************/
+    static void End(const char *name, unsigned session);
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Scoped zone. Records a begin event when constructed and an end event
+  when destroyed. Use through BT_ZONE.
+  */
+  /*****************************************/
+  class Zone
+  {
+  public:
+    /*****************************************/
+    /*!
+    \brief
+    Conversion constructor. Begins the zone.
+
+    \param name
+    Name of the zone. Must be a string literal.
+    */
+    /*****************************************/
+    Zone(const char *name) : name(name), session(Zones::Begin(name)) {}
+
+    /*****************************************/
+    /*!
+    \brief
+    Destructor. Ends the zone.
+    */
+    /*****************************************/
+    ~Zone() { Zones::End(name, session); }
+
+  private:
+    const char *name; //!< Name of the zone
+    unsigned session; //!< Session the zone began in, 0 if dropped
+  };
+}
+
+#endif
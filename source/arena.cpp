@@ -0,0 +1,120 @@
+/******************************************************************************/
+/*!
+\file arena.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Double-buffered per-frame linear allocator and STL allocator adapter.
+*/
+/******************************************************************************/
+#include "brewtools/arena.h" // FrameArena class
+#include <cstdlib>           // malloc, free
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  /*****************************************/
+  /*!
+  \brief
+  Default constructor.
+
+  \param size
+  Bytes in each of the two buffers.
+  */
+  /*****************************************/
+  FrameArena::FrameArena(size_t size)
+    : size(size), current(0), highwater(0), lastheapallocs(0), offset(0),
+      heapallocs(0)
+  {
+    buffers[0] = new char[size];
+    buffers[1] = new char[size];
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Destructor. Frees both buffers and any heap fallbacks.
+  */
+  /*****************************************/
+  FrameArena::~FrameArena()
+  {
+    for (unsigned i = 0; i < 2; ++i)
+    {
+      for (auto it : overflow[i])
+        free(it);
+      delete[] buffers[i];
+    }
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Allocates memory that lives until the end of the next frame.
+  Heap fallbacks are only aligned for std::max_align_t.
+
+  \param bytes
+  Bytes to allocate.
+
+  \param align
+  Alignment of the allocation. Must be a power of 2.
+
+  \return
+  Pointer to the memory. Never nullptr.
+  */
+  /*****************************************/
+  void *FrameArena::Allocate(size_t bytes, size_t align)
+  {
+    size_t start, end;
+    #ifndef BT_NO_THREADS
+    size_t old = offset;
+    do
+    {
+      start = (old + align - 1) & ~(align - 1);
+      end = start + bytes;
+      if (end > size) break;
+    } while (!offset.compare_exchange_weak(old, end));
+    #else
+    start = (offset + align - 1) & ~(align - 1);
+    end = start + bytes;
+    if (end <= size) offset = end;
+    #endif
+    if (end <= size) return buffers[current] + start;
+
+    // Doesn't fit. Fall back to the heap until this buffer is reset
+    ++heapallocs;
+    void *mem = malloc(bytes ? bytes : 1);
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> lock(overflowlock);
+    #endif
+    overflow[current].push_back(mem);
+    return mem;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Ends the frame. Swaps to the other buffer and resets it.
+  */
+  /*****************************************/
+  void FrameArena::Flip()
+  {
+    if (offset > highwater) highwater = offset;
+    lastheapallocs = heapallocs;
+    heapallocs = 0;
+    current ^= 1;
+    for (auto it : overflow[current])
+      free(it);
+    overflow[current].clear();
+    offset = 0;
+  }
+}
@@ -76,7 +76,7 @@ namespace BrewTools
     if (m_selected)
     {
       Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
-      (*trace)[0] << "Currently selected console is being deleted...";
+      BT_TRACE_TO(trace, 0, "Currently selected console is being deleted...");
       trace->SelectConsole(nullptr);
     }
     #ifdef _WIN32 //The following only exists in a Windows build
@@ -114,9 +114,11 @@ namespace BrewTools
     Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
     if (trace)
     {
-      (*trace)[5] << "GFXWindow::GetTarget() only works on 3DS";
-      (*trace)[1] << "WARNING: *SEVERE* problems are caused "
-                     "if your code depends on GFXWindow::GetTarget().";
+      BT_TRACE_TO(trace, 5, "GFXWindow::GetTarget() only works on 3DS");
+      BT_TRACE_TO(
+        trace, 1, "WARNING: *SEVERE* problems are caused "
+                  "if your code depends on GFXWindow::GetTarget()."
+      );
     }
     return nullptr;
   #endif
@@ -0,0 +1,301 @@
+/******************************************************************************/
+/*!
+\file coroutines.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Stackless coroutines resumed by the Engine each frame.
+*/
+/******************************************************************************/
+#include "brewtools/coroutines.h" // Coroutines class
+#include "brewtools/distillery.h" // Engine class
+#include "brewtools/time.h"       // Time class
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  //! Bits of a CoroutineID holding its slot index
+  static const CoroutineID COROUTINE_INDEX_MASK = 0xFFFFF;
+  //! Shift of a CoroutineID's generation
+  static const unsigned COROUTINE_GENERATION_SHIFT = 20;
+
+  /*****************************************/
+  /*!
+  \brief
+  Conversion constructor.
+
+  \param engine
+  Engine whose job system runs coroutines on workers.
+  */
+  /*****************************************/
+  Coroutines::Coroutines(Engine *engine)
+    : engine(engine), frame(0), living(0)
+  {
+    // Slot 0 is never used, so no handle is 0
+    Slot slot = { nullptr, 0 };
+    slots.push_back(slot);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Destructor. Destroys unfinished coroutines and frees the pool.
+  */
+  /*****************************************/
+  Coroutines::~Coroutines()
+  {
+    for (auto &it : slots)
+      if (it.coroutine) it.coroutine->~Coroutine();
+    for (auto it : slabs)
+      delete[] it;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Stops a coroutine the next time it would be resumed.
+
+  \param id
+  Handle of the coroutine.
+  */
+  /*****************************************/
+  void Coroutines::Cancel(CoroutineID id)
+  {
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
+    CoroutineID index = id & COROUTINE_INDEX_MASK;
+    if (index >= slots.size()) return;
+    Slot &slot = slots[index];
+    if (slot.coroutine &&
+        slot.generation == (id >> COROUTINE_GENERATION_SHIFT))
+      slot.coroutine->cancelled = true;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Determines if a coroutine hasn't finished yet.
+
+  \param id
+  Handle of the coroutine.
+  */
+  /*****************************************/
+  bool Coroutines::Alive(CoroutineID id)
+  {
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
+    CoroutineID index = id & COROUTINE_INDEX_MASK;
+    if (!index || index >= slots.size()) return false;
+    const Slot &slot = slots[index];
+    return slot.coroutine &&
+      slot.generation == (id >> COROUTINE_GENERATION_SHIFT);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Resumes every coroutine that is done waiting.
+  A coroutine keeps running until it waits for something that hasn't
+  happened yet, so waiting on a finished coroutine doesn't cost a frame.
+  */
+  /*****************************************/
+  void Coroutines::Update()
+  {
+    ++frame;
+    {
+      #ifndef BT_NO_THREADS
+      std::lock_guard<std::mutex> guard(lock);
+      #endif
+      if (incoming.empty() && active.empty()) return;
+      // Workers leave waits relative, they're made absolute here
+      uint64_t now = Time::Current();
+      for (auto it : incoming)
+      {
+        if (it->wait == Coroutine::WAIT_FRAMES) it->until += frame - 1;
+        else if (it->wait == Coroutine::WAIT_TIME) it->until += now;
+        active.push_back(it);
+      }
+      incoming.clear();
+    }
+
+    unsigned kept = 0;
+    for (unsigned i = 0; i < active.size(); ++i)
+    {
+      Coroutine *coroutine = active[i];
+      bool finished = coroutine->cancelled;
+      while (!finished && Ready(coroutine))
+      {
+        #ifndef BT_NO_THREADS
+        if (coroutine->wait == Coroutine::WAIT_WORKER)
+          break;
+        #endif
+        finished = coroutine->Resume();
+        if (coroutine->wait == Coroutine::WAIT_FRAMES)
+          coroutine->until += frame;
+        else if (coroutine->wait == Coroutine::WAIT_TIME)
+          coroutine->until += Time::Current();
+      }
+      if (finished)
+        Destroy(coroutine);
+      #ifndef BT_NO_THREADS
+      else if (coroutine->wait == Coroutine::WAIT_WORKER)
+        engine->GetJobs().Push([this, coroutine]() {
+          Engine::Scope scope(engine);
+          RunOnWorker(coroutine);
+        });
+      #endif
+      else
+        active[kept++] = coroutine;
+    }
+    active.resize(kept);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets memory for a coroutine from the pool.
+  Sizes are rounded up to a multiple of 64 bytes, each with its own free
+  list. A class with no free blocks gets a slab of BT_COROUTINE_SLAB.
+
+  \param size
+  Size of the coroutine.
+  */
+  /*****************************************/
+  void *Coroutines::Allocate(size_t size)
+  {
+    if (size > BT_COROUTINE_POOL_MAX) return new char[size];
+    unsigned sizeclass = (size - 1) / 64;
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
+    std::vector<void *> &blocks = freeblocks[sizeclass];
+    if (blocks.empty())
+    {
+      size_t blocksize = (sizeclass + 1) * 64;
+      char *slab = new char[blocksize * BT_COROUTINE_SLAB];
+      slabs.push_back(slab);
+      for (unsigned i = BT_COROUTINE_SLAB; i > 0; --i)
+        blocks.push_back(slab + (i - 1) * blocksize);
+    }
+    void *block = blocks.back();
+    blocks.pop_back();
+    return block;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gives a slot to a started coroutine and queues it.
+
+  \return
+  Handle of the coroutine.
+  */
+  /*****************************************/
+  CoroutineID Coroutines::Add(Coroutine *coroutine, size_t size)
+  {
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
+    uint32_t index;
+    if (!freeslots.empty())
+    {
+      index = freeslots.back();
+      freeslots.pop_back();
+    }
+    else
+    {
+      index = slots.size();
+      Slot slot = { nullptr, 0 };
+      slots.push_back(slot);
+    }
+    Slot &slot = slots[index];
+    slot.coroutine = coroutine;
+    coroutine->size = size;
+    coroutine->id = index | (slot.generation << COROUTINE_GENERATION_SHIFT);
+    incoming.push_back(coroutine);
+    ++living;
+    return coroutine->id;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Frees a coroutine's slot and returns its memory to the pool.
+  */
+  /*****************************************/
+  void Coroutines::Destroy(Coroutine *coroutine)
+  {
+    size_t size = coroutine->size;
+    CoroutineID index = coroutine->id & COROUTINE_INDEX_MASK;
+    coroutine->~Coroutine();
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
+    Slot &slot = slots[index];
+    slot.coroutine = nullptr;
+    slot.generation = (slot.generation + 1) &
+      (0xFFFFFFFF >> COROUTINE_GENERATION_SHIFT);
+    freeslots.push_back(index);
+    --living;
+    if (size > BT_COROUTINE_POOL_MAX)
+      delete[] (char *)coroutine;
+    else
+      freeblocks[(size - 1) / 64].push_back(coroutine);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Determines if a coroutine is done waiting on the main thread.
+  */
+  /*****************************************/
+  bool Coroutines::Ready(Coroutine *coroutine)
+  {
+    switch (coroutine->wait)
+    {
+      case Coroutine::WAIT_FRAMES:
+        return frame >= coroutine->until;
+      case Coroutine::WAIT_TIME:
+        return Time::Current() >= coroutine->until;
+      case Coroutine::WAIT_COROUTINE:
+        return !Alive(CoroutineID(coroutine->until));
+      default:
+        return true;
+    }
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Runs a coroutine on a worker until it suspends for anything else, then
+  hands it back to the main thread.
+  */
+  /*****************************************/
+  void Coroutines::RunOnWorker(Coroutine *coroutine)
+  {
+    bool finished = coroutine->cancelled;
+    while (!finished && coroutine->wait == Coroutine::WAIT_WORKER)
+      finished = coroutine->Resume();
+    if (finished)
+    {
+      Destroy(coroutine);
+      return;
+    }
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
+    incoming.push_back(coroutine);
+  }
+}
@@ -15,7 +15,10 @@ Core of the engine. Holds pointers to all other major systems.
 #include "brewtools/distillery.h" // Engine class
 #include "brewtools/trace.h"      // Trace class
 #include "brewtools/graphics.h"   // Graphics class
-#include "brewtools/time.h"   // Time class
+#include "brewtools/time.h"       // Time class
+#include "brewtools/zones.h"      // BT_ZONE
+#include <algorithm>              // std::sort
+#include <sstream>                // std::stringstream
 
 /*****************************************/
 /*!
@@ -25,13 +28,51 @@ Brewtools namespace.
 /*****************************************/
 namespace BrewTools
 {
+  //! System currently being updated by this thread (for race checking)
+  static thread_local ProtoSystem *currentsystem = nullptr;
+  //! Engine running code on this thread, nullptr for the default one
+  static thread_local Engine *currentengine = nullptr;
+
   /*****************************************/
   /*!
   \brief
-  Default constructor. Called by Get.
+  Conversion constructor. Called by Get and Create.
+
+  \param primary
+  true for the default Engine.
   */
   /*****************************************/
-  Engine::Engine() {}
+  Engine::Engine(bool primary) : highest(0), primary(primary),
+  raceviolations(0), modules(this), coroutines(this), watchdog(this),
+  recorder(&events), fixedstep(0),
+  maxfixedsteps(0), accumulator(0), lastframe(0), alpha(0), fixedpass(false),
+  framecount(0), always(0), due(0), awake(0), served(0), rewoken(0), woken(0),
+  phaseversion(0), phasesdirty(true),
+  currentphase(ProtoSystem::PHASE_UPDATE), updated(0), profiledump(0),
+  profilelevel(1), profileframes(0), headless(false), startuptime(0)
+  #ifndef BT_NO_THREADS
+  , remaining(0), mainhead(0), maintail(0)
+  #endif
+  {
+    for (SysID i = 0; i < BT_MAX_SYSTEMS; ++i)
+    {
+      systems[i] = nullptr;
+      caches[i] = nullptr;
+      claimed[i] = false;
+      #ifndef BT_NO_THREADS
+      builders[i] = std::thread::id();
+      #endif
+      registrations[i].factory = nullptr;
+      inittimes[i] = 0;
+      nextupdate[i] = 0;
+    }
+    for (unsigned p = 0; p < ProtoSystem::PHASE_COUNT; ++p)
+      phasemasks[p] = 0;
+    Register<Trace>();
+    Register<Time, Trace>();
+    // GLFW and the GL context must stay on the main thread
+    Register<Graphics, Trace, Time>(INIT_MAIN_THREAD);
+  }
   
   /*****************************************/
   /*!
@@ -41,10 +82,225 @@ namespace BrewTools
   /*****************************************/
   Engine::~Engine()
   {
-    for (auto it : systems)
-      delete it.second;
+    // System destructors use Get
+    Scope scope(this);
+    jobs.SetWorkerCount(0);
+    for (SysID i = 1; i <= highest; ++i)
+    {
+      if (caches[i]) *caches[i] = nullptr;
+      delete systems[i];
+      systems[i] = nullptr;
+    }
   }
   
+  /*****************************************/
+  /*!
+  \brief
+  Stores a newly created system in the registry.
+
+  \param id
+  ID of the system.
+
+  \param system
+  Pointer to the system.
+
+  \param cache
+  Per-type cache to fill with the system, nullptr if it has none.
+
+  \param start
+  Clock time the system started being created, for the startup report.
+
+  \return
+  true if the system was stored, false if the id is out of range.
+  */
+  /*****************************************/
+  bool Engine::AddSystem(
+    SysID id, ProtoSystem *system, SystemSlot *cache, uint64_t start
+  )
+  {
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> lock(addmutex);
+    #endif
+    if (id == 0 || id >= BT_MAX_SYSTEMS)
+    {
+      Trace *trace = GetSystemIfExists<Trace>();
+      BT_TRACE_TO(trace, 0, "Too many system types! Raise BT_MAX_SYSTEMS");
+      return false;
+    }
+    systems[id] = system;
+    caches[id] = cache;
+    phasesdirty = true;
+    inittimes[id] = Clock() - start;
+    if (cache) *cache = system;
+    if (id > highest) highest = id;
+    return true;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Stores how to create a system.
+
+  \param id
+  ID of the system.
+
+  \param factory
+  Function creating the system.
+
+  \param cache
+  Per-type cache of the system.
+
+  \param deps
+  Bit per SysID that must be created first.
+
+  \param flags
+  InitFlags.
+  */
+  /*****************************************/
+  void Engine::RegisterFactory(
+    SysID id, Factory factory, SystemSlot *cache, uint64_t deps,
+    unsigned flags
+  )
+  {
+    if (id == 0 || id >= BT_MAX_SYSTEMS) return;
+    registrations[id].factory = factory;
+    registrations[id].cache = primary ? cache : nullptr;
+    registrations[id].deps = deps & ~(uint64_t(1) << id);
+    registrations[id].flags = flags;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Claims the creation of a system, so only one thread creates it.
+
+  \param id
+  ID of the system.
+
+  \return
+  true if the calling thread should create the system, false if another
+  thread already is.
+  */
+  /*****************************************/
+  bool Engine::Claim(SysID id)
+  {
+    // Out of range IDs are turned down by AddSystem
+    if (id >= BT_MAX_SYSTEMS) return true;
+    #ifndef BT_NO_THREADS
+    if (claimed[id].exchange(true)) return false;
+    builders[id] = std::this_thread::get_id();
+    return true;
+    #else
+    bool first = !claimed[id];
+    claimed[id] = true;
+    return first;
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Ends a claim once the system is stored, or gives it back if the system
+  couldn't be created.
+
+  \param id
+  ID of the system.
+
+  \param created
+  true if the system was stored.
+  */
+  /*****************************************/
+  void Engine::Release(SysID id, bool created)
+  {
+    if (id >= BT_MAX_SYSTEMS) return;
+    #ifndef BT_NO_THREADS
+    builders[id] = std::thread::id();
+    #endif
+    if (!created) claimed[id] = false;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Waits for another thread to finish creating a system, running jobs in
+  the meantime so a constructor waiting on jobs can't deadlock it.
+
+  \param id
+  ID of the system.
+
+  \return
+  Pointer to the system, nullptr if it asked for itself or couldn't be
+  created.
+  */
+  /*****************************************/
+  ProtoSystem *Engine::Await(SysID id)
+  {
+    if (id >= BT_MAX_SYSTEMS) return nullptr;
+    ProtoSystem *system;
+    #ifndef BT_NO_THREADS
+    bool reentered = builders[id] == std::this_thread::get_id();
+    #else
+    // Without threads, an unfinished claim can only be our own
+    bool reentered = !systems[id] && claimed[id];
+    #endif
+    if (reentered)
+    {
+      Trace *trace = GetSystemIfExists<Trace>();
+      BT_TRACE_TO(trace, 0, "System " << id <<
+        " was asked for by its own constructor! Pass it in instead");
+      return nullptr;
+    }
+    while (!(system = systems[id]))
+    {
+      // The creating thread gave up
+      if (!claimed[id]) return nullptr;
+      #ifndef BT_NO_THREADS
+      if (!jobs.TryRunOne())
+        std::this_thread::yield();
+      #endif
+    }
+    return system;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Creates a registered system and stores it.
+
+  \param id
+  ID of the system.
+  */
+  /*****************************************/
+  void Engine::InitSystem(SysID id)
+  {
+    // A constructor may have already asked for it with GetSystem
+    if (!Claim(id)) return;
+    uint64_t start = Clock();
+    ProtoSystem *system;
+    {
+      Scope scope(this);
+      AllocTag tag(id);
+      system = registrations[id].factory();
+    }
+    if (!AddSystem(id, system, registrations[id].cache, start))
+    {
+      Release(id, false);
+      delete system;
+    }
+    else Release(id, true);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets the clock used to time system creation, in us.
+  */
+  /*****************************************/
+  uint64_t Engine::Clock()
+  {
+    return Time::Precise();
+  }
+
   /*****************************************/
   /*!
   \brief
@@ -56,21 +312,131 @@ namespace BrewTools
   /*****************************************/
   Engine *Engine::Get()
   {
-    static Engine *engine = new Engine;
+    if (currentengine) return currentengine;
+    static Engine *engine = new Engine(true);
     return engine;
   }
+
+  /*****************************************/
+  /*!
+  \brief
+  Creates an Engine separate from the default one.
+
+  \return
+  The new Engine.
+  */
+  /*****************************************/
+  Engine *Engine::Create()
+  {
+    return new Engine(false);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Makes an Engine the current one of the calling thread.
+
+  \param engine
+  The new current Engine, nullptr for the default one.
+
+  \return
+  The previous current Engine.
+  */
+  /*****************************************/
+  Engine *Engine::Swap(Engine *engine)
+  {
+    Engine *previous = currentengine;
+    currentengine = engine;
+    return previous;
+  }
   
   /*****************************************/
   /*!
   \brief
-  Initializes all systems.
+  Creates every registered system that isn't lazy.
+  Systems whose dependencies are met are created together, in parallel
+  on the job system unless they need the main thread. A startup report
+  with each system's creation time is written to Trace at level 1.
   */
   /*****************************************/
   void Engine::InitializeAll()
   {
-    GetSystem<Trace>();
-    GetSystem<Graphics>();
-    GetSystem<Time>();
+    uint64_t start = Clock();
+    uint64_t todo = 0;
+    for (SysID i = 1; i < BT_MAX_SYSTEMS; ++i)
+    {
+      if (registrations[i].factory && !systems[i] &&
+          !(registrations[i].flags & INIT_LAZY))
+        todo |= uint64_t(1) << i;
+    }
+    // Registered dependencies are created first even if they are lazy
+    for (bool grew = true; grew;)
+    {
+      grew = false;
+      for (SysID i = 1; i < BT_MAX_SYSTEMS; ++i)
+      {
+        if (!(todo & (uint64_t(1) << i))) continue;
+        for (SysID j = 1; j < BT_MAX_SYSTEMS; ++j)
+        {
+          uint64_t bit = uint64_t(1) << j;
+          if ((registrations[i].deps & bit) && !(todo & bit) &&
+              !systems[j] && registrations[j].factory)
+          {
+            todo |= bit;
+            grew = true;
+          }
+        }
+      }
+    }
+
+    while (todo)
+    {
+      // A wave is every system whose dependencies are all created
+      uint64_t wave = 0;
+      for (SysID i = 1; i < BT_MAX_SYSTEMS; ++i)
+        if ((todo & (uint64_t(1) << i)) && !(registrations[i].deps & todo))
+          wave |= uint64_t(1) << i;
+      if (!wave)
+      {
+        Trace *trace = GetSystemIfExists<Trace>();
+        BT_TRACE_TO(
+          trace, 0, "Cyclic system dependencies! Creating in ID order"
+        );
+        wave = todo;
+      }
+      todo &= ~wave;
+      {
+        TaskGroup group(&jobs);
+        for (SysID i = 1; i < BT_MAX_SYSTEMS; ++i)
+        {
+          if (!(wave & (uint64_t(1) << i)) ||
+              (registrations[i].flags & INIT_MAIN_THREAD))
+            continue;
+          group.Run([this, i]() { InitSystem(i); });
+        }
+        for (SysID i = 1; i < BT_MAX_SYSTEMS; ++i)
+          if ((wave & (uint64_t(1) << i)) &&
+              (registrations[i].flags & INIT_MAIN_THREAD))
+            InitSystem(i);
+        group.Wait();
+      }
+    }
+    startuptime = Clock() - start;
+
+    Trace *trace = GetSystemIfExists<Trace>();
+    if (!trace) return;
+    std::stringstream line;
+    line << "Startup took " << startuptime << "us";
+    BT_TRACE_TO(trace, 1, line.str());
+    for (SysID i = 1; i <= highest; ++i)
+    {
+      if (!systems[i]) continue;
+      line.str("");
+      if (profiler.GetName(i)) line << "  " << profiler.GetName(i);
+      else line << "  System " << i;
+      line << ": " << inittimes[i] << "us";
+      BT_TRACE_TO(trace, 1, line.str());
+    }
   }
   
   /*****************************************/
@@ -89,17 +455,475 @@ namespace BrewTools
   /*!
   \brief
   Updates all living systems.
+
+  \return
+  false once a replay has run out of recorded frames, true otherwise.
   */
   /*****************************************/
   bool Engine::Update()
   {
+    #ifdef BT_ZONES
+    // Last frame's zones have all closed by now
+    Zones::Flush();
+    #endif
+    BT_ZONE("Engine::Update");
+    Scope scope(this);
     BrewTools::Trace *trace = GetSystemIfExists<BrewTools::Trace>();
-    if (trace)
-      (*trace)[5] << "Updating the engine...";
-    for (auto it : systems)
-      it.second->Update();
-    if (trace)
-      (*trace)[5] << "Engine updated!";
+    BT_TRACE_TO(trace, 5, "Updating the engine...");
+    if (!recorder.BeginFrame())
+      return false;
+    bool timed = profiler.IsEnabled() || watchdog.IsEnabled();
+    uint64_t framestart = timed ? Time::Precise() : 0;
+    // Nothing is updating yet, so reloaded modules can be swapped in
+    modules.Poll();
+    if (phasesdirty || phaseversion != ProtoSystem::GetPhaseVersion())
+      SortPhases();
+    ScheduleFrame();
+    for (unsigned p = 0; p < ProtoSystem::PHASE_COUNT; ++p)
+    {
+      currentphase = ProtoSystem::Phase(p);
+      if (currentphase == ProtoSystem::PHASE_UPDATE && fixedstep)
+      {
+        uint64_t now = Time::Precise();
+        accumulator += recorder.Elapsed(now - lastframe);
+        lastframe = now;
+        // Drop time we can't catch up on instead of spiraling
+        if (accumulator > fixedstep * maxfixedsteps)
+          accumulator = fixedstep * maxfixedsteps;
+        fixedpass = true;
+        while (accumulator >= fixedstep)
+        {
+          updated |= phasemasks[p];
+          RunPass(phases[p]);
+          accumulator -= fixedstep;
+        }
+        fixedpass = false;
+        alpha = float(accumulator) / float(fixedstep);
+      }
+      if (currentphase == ProtoSystem::PHASE_UPDATE)
+        coroutines.Update();
+      RunPass(GetActive(p));
+      recorder.EndPhase(p);
+      events.Dispatch();
+    }
+    // Wakes that came after a system's last phase carry over
+    awake = (awake & ~served) | rewoken;
+    served = rewoken = 0;
+    ++framecount;
+    // Without workers, jobs pushed this frame are run here
+    if (!jobs.GetWorkerCount())
+      while (jobs.TryRunOne()) {}
+    uint64_t frametime = timed ? Time::Precise() - framestart : 0;
+    // The watchdog reads this frame's allocations and system times, so it
+    // goes between the two. Allocation counts are process wide, so only
+    // the default Engine's frames roll them over
+    if (primary) MemTrack::EndFrame();
+    watchdog.EndFrame(frametime);
+    if (profiler.IsEnabled())
+    {
+      profiler.EndFrame(frametime, updated);
+      if (profiledump && ++profileframes >= profiledump)
+      {
+        profileframes = 0;
+        if (trace)
+        {
+          profiler.Dump(*trace, profilelevel);
+          #ifdef BT_TRACK_ALLOCATIONS
+          MemTrack::Dump(*trace, profilelevel);
+          #endif
+        }
+      }
+    }
+    recorder.EndFrame();
+    BT_TRACE_TO(trace, 5, "Engine updated!");
+    arena.Flip();
     return true;
   }
+
+  /*****************************************/
+  /*!
+  \brief
+  Sets the fixed simulation step.
+  Each Engine::Update then accumulates the time since the last one and
+  calls FixedUpdate on every system once per whole step before Update.
+
+  \param step
+  Length of a step in microseconds. 0 disables fixed stepping.
+
+  \param maxsteps
+  Max steps per Update. Time beyond this is dropped.
+  */
+  /*****************************************/
+  void Engine::SetFixedStep(uint64_t step, unsigned maxsteps)
+  {
+    fixedstep = step;
+    maxfixedsteps = maxsteps ? maxsteps : 1;
+    accumulator = 0;
+    alpha = 0;
+    lastframe = Time::Precise();
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Periodically writes the profiler's statistics through Trace, along
+  with per-system allocations when BT_TRACK_ALLOCATIONS is defined.
+
+  \param frames
+  Frames between dumps. 0 stops dumping.
+
+  \param level
+  Trace level to write at.
+  */
+  /*****************************************/
+  void Engine::SetProfileDump(unsigned frames, unsigned level)
+  {
+    profiledump = frames;
+    profilelevel = level;
+    profileframes = 0;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Rebuilds the per-phase lists of systems, sorted by priority then SysID.
+  */
+  /*****************************************/
+  void Engine::SortPhases()
+  {
+    // Workers can add systems while the phases are being built
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> lock(addmutex);
+    #endif
+    always = 0;
+    throttled.clear();
+    for (SysID i = 1; i <= highest; ++i)
+    {
+      if (!systems[i]) continue;
+      Throttle throttle;
+      throttle.id = i;
+      throttle.policy = systems[i]->GetUpdatePolicy();
+      throttle.value = systems[i]->GetUpdateValue();
+      if (throttle.policy == ProtoSystem::UPDATE_ALWAYS)
+        always |= uint64_t(1) << i;
+      else
+        throttled.push_back(throttle);
+    }
+    for (unsigned p = 0; p < ProtoSystem::PHASE_COUNT; ++p)
+    {
+      ProtoSystem::Phase phase = ProtoSystem::Phase(p);
+      std::vector<SysID> &list = phases[p];
+      list.clear();
+      phasemasks[p] = 0;
+      for (SysID i = 1; i <= highest; ++i)
+      {
+        if (systems[i] && systems[i]->InPhase(phase))
+        {
+          list.push_back(i);
+          phasemasks[p] |= uint64_t(1) << i;
+        }
+      }
+      std::sort(list.begin(), list.end(), [this, phase](SysID a, SysID b) {
+        int pa = systems[a]->GetPriority(phase);
+        int pb = systems[b]->GetPriority(phase);
+        return (pa != pb) ? pa < pb : a < b;
+      });
+    }
+    phaseversion = ProtoSystem::GetPhaseVersion();
+    phasesdirty = false;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Finds the systems whose update policy updates them this frame.
+  UPDATE_EVERY_N systems are staggered by SysID, so systems sharing an N
+  don't all land on the same frame.
+  */
+  /*****************************************/
+  void Engine::ScheduleFrame()
+  {
+    updated = 0;
+    due = always;
+    if (throttled.empty()) return;
+    uint64_t now = Time::Current() * 1000;
+    for (auto &it : throttled)
+    {
+      uint64_t bit = uint64_t(1) << it.id;
+      switch (it.policy)
+      {
+      case ProtoSystem::UPDATE_EVERY_N:
+        if ((framecount + it.id) % it.value == 0) due |= bit;
+        break;
+      case ProtoSystem::UPDATE_FREQUENCY:
+        if (now < nextupdate[it.id]) break;
+        due |= bit;
+        nextupdate[it.id] += 1000000 / it.value;
+        // Skip the updates missed while idle instead of bursting
+        if (nextupdate[it.id] <= now)
+          nextupdate[it.id] = now + 1000000 / it.value;
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets the systems of a phase that update this frame, leaving out idle
+  ones without touching them.
+
+  \param phase
+  Phase being dispatched.
+
+  \return
+  Systems to update, in update order.
+  */
+  /*****************************************/
+  const std::vector<SysID> &Engine::GetActive(unsigned phase)
+  {
+    #ifndef BT_NO_THREADS
+    uint64_t fresh = woken.exchange(0);
+    #else
+    uint64_t fresh = woken;
+    woken = 0;
+    #endif
+    rewoken |= fresh & served;
+    awake |= fresh;
+    uint64_t run = phasemasks[phase] & (due | awake);
+    updated |= run;
+    served |= run & awake;
+    if (run == phasemasks[phase]) return phases[phase];
+    active.clear();
+    for (auto it : phases[phase])
+      if (run & (uint64_t(1) << it)) active.push_back(it);
+    return active;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Makes a system update in its next phase, whatever its update policy.
+
+  \param id
+  ID of the system to wake.
+  */
+  /*****************************************/
+  void Engine::Wake(SysID id)
+  {
+    if (id < BT_MAX_SYSTEMS) woken |= uint64_t(1) << id;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Updates every system in a phase once, in parallel if there are workers.
+  Calls FixedUpdate instead during the fixed pass.
+
+  \param list
+  Systems in the phase, in update order.
+  */
+  /*****************************************/
+  void Engine::RunPass(const std::vector<SysID> &list)
+  {
+    if (list.empty()) return;
+    #ifndef BT_NO_THREADS
+    if (jobs.GetWorkerCount())
+      RunParallel(list);
+    else
+    #endif
+    for (auto it : list)
+      RunSystem(it);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Updates (or fixed updates) a single system, tracking it for race checking.
+
+  \param id
+  ID of the system to update.
+  */
+  /*****************************************/
+  void Engine::RunSystem(SysID id)
+  {
+    bool timed = profiler.IsEnabled();
+    uint64_t start = timed ? Time::Precise() : 0;
+    Scope scope(this);
+    AllocTag tag(id);
+    currentsystem = systems[id];
+    if (fixedpass) systems[id]->FixedUpdate();
+    else systems[id]->PhaseUpdate(currentphase);
+    currentsystem = nullptr;
+    if (timed) profiler.Record(id, Time::Precise() - start);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Checks that the currently updating system declared access to a system.
+  Undeclared systems are updated alone on the calling thread, so they are
+  never flagged.
+
+  \param id
+  ID of the system being accessed.
+  */
+  /*****************************************/
+  void Engine::CheckAccess(SysID id)
+  {
+    ProtoSystem *sys = currentsystem;
+    if (!sys || !sys->IsAccessDeclared() || id >= BT_MAX_SYSTEMS) return;
+    if (sys == systems[id]) return;
+    uint64_t bit = uint64_t(1) << id;
+    if ((sys->GetReadMask() | sys->GetWriteMask()) & bit) return;
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> lock(racemutex);
+    #endif
+    ++raceviolations;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Sets the number of worker threads used to update systems.
+
+  \param count
+  Number of worker threads in addition to the calling thread.
+  */
+  /*****************************************/
+  void Engine::SetWorkerCount(unsigned count)
+  {
+    jobs.SetWorkerCount(count);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets the number of worker threads used to update systems.
+  */
+  /*****************************************/
+  unsigned Engine::GetWorkerCount() const
+  {
+    return jobs.GetWorkerCount();
+  }
+
+  #ifndef BT_NO_THREADS
+  /*****************************************/
+  /*!
+  \brief
+  Builds the phase's dependency graph and updates its systems with the
+  job system.
+  A system depends on every earlier system in the list it conflicts with:
+  one writes something the other reads or writes. Every system writes
+  itself, and undeclared systems conflict with everything. Undeclared and
+  main thread only systems are updated by the calling thread, the rest by
+  whichever thread is free.
+
+  \param list
+  Systems in the phase, in update order.
+  */
+  /*****************************************/
+  void Engine::RunParallel(const std::vector<SysID> &list)
+  {
+    uint64_t reads[BT_MAX_SYSTEMS];
+    uint64_t writes[BT_MAX_SYSTEMS];
+    unsigned count = list.size();
+    mainhead = maintail = 0;
+    for (unsigned n = 0; n < count; ++n)
+    {
+      SysID j = list[n];
+      pending[j] = 0;
+      dependents[j] = 0;
+      if (systems[j]->IsAccessDeclared())
+      {
+        reads[j] = systems[j]->GetReadMask();
+        writes[j] = systems[j]->GetWriteMask() | (uint64_t(1) << j);
+      }
+      else
+        reads[j] = writes[j] = ~uint64_t(0);
+      for (unsigned m = 0; m < n; ++m)
+      {
+        SysID i = list[m];
+        if ((writes[i] & (reads[j] | writes[j])) || (writes[j] & reads[i]))
+        {
+          dependents[i] |= uint64_t(1) << j;
+          ++pending[j];
+        }
+      }
+    }
+    remaining = count;
+    // Roots are gathered first, a finishing root may zero pending for others
+    SysID roots[BT_MAX_SYSTEMS];
+    unsigned rootcount = 0;
+    for (auto it : list)
+      if (!pending[it]) roots[rootcount++] = it;
+    for (unsigned n = 0; n < rootcount; ++n)
+      Dispatch(roots[n]);
+
+    // The main thread updates its own systems and helps with the rest
+    while (remaining)
+    {
+      SysID id = 0;
+      {
+        std::lock_guard<std::mutex> lock(mainmutex);
+        if (mainhead != maintail) id = mainready[mainhead++];
+      }
+      if (id)
+      {
+        RunSystem(id);
+        FinishSystem(id);
+      }
+      else if (!jobs.TryRunOne())
+        std::this_thread::yield();
+    }
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Hands a system whose dependencies are done to a thread that can
+  update it. Systems that haven't declared their accesses may touch
+  anything that isn't thread safe, so they stay on the calling thread.
+
+  \param id
+  ID of the ready system.
+  */
+  /*****************************************/
+  void Engine::Dispatch(SysID id)
+  {
+    if (systems[id]->IsMainThreadOnly() || !systems[id]->IsAccessDeclared())
+    {
+      std::lock_guard<std::mutex> lock(mainmutex);
+      mainready[maintail++] = id;
+    }
+    else
+    {
+      jobs.Push([this, id]() {
+        RunSystem(id);
+        FinishSystem(id);
+      });
+    }
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Marks a system as updated and dispatches the systems waiting on it.
+
+  \param id
+  ID of the finished system.
+  */
+  /*****************************************/
+  void Engine::FinishSystem(SysID id)
+  {
+    for (SysID j = 1; j <= highest; ++j)
+    {
+      if ((dependents[id] & (uint64_t(1) << j)) && --pending[j] == 0)
+        Dispatch(j);
+    }
+    --remaining;
+  }
+  #endif
 }
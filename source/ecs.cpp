@@ -0,0 +1,401 @@
+/******************************************************************************/
+/*!
+\file ecs.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Archetype based entity component system.
+*/
+/******************************************************************************/
+#include "brewtools/ecs.h"   // ECS class
+#include "brewtools/trace.h" // Trace class
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  static ComponentID componentcount; //!< Total number of ComponentIDs
+  static size_t componentsizes[BT_MAX_COMPONENTS]; //!< Sizes by ComponentID
+  static size_t componentaligns[BT_MAX_COMPONENTS]; //!< Alignments by ID
+
+  //! Bits of an Entity holding its index
+  static const Entity ENTITY_INDEX_MASK = 0xFFFFFF;
+  //! Shift of an Entity's generation
+  static const unsigned ENTITY_GENERATION_SHIFT = 24;
+
+  /*****************************************/
+  /*!
+  \brief
+  Default constructor.
+  The ECS only stores entities, so it isn't in any update phase.
+  */
+  /*****************************************/
+  ECS::ECS() : empty(nullptr), living(0)
+  {
+    RemovePhase(PHASE_UPDATE);
+    empty = GetArchetype(0);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Destructor. Frees every chunk.
+  */
+  /*****************************************/
+  ECS::~ECS()
+  {
+    for (auto &it : archetypes)
+    {
+      for (auto chunk : it.second->chunks)
+      {
+        delete[] chunk->data;
+        delete chunk;
+      }
+      delete it.second;
+    }
+    for (auto it : queries)
+      delete it;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Creates an entity without components.
+
+  \return
+  Handle of the entity.
+  */
+  /*****************************************/
+  Entity ECS::Create()
+  {
+    unsigned index;
+    if (!freeindices.empty())
+    {
+      index = freeindices.back();
+      freeindices.pop_back();
+    }
+    else
+    {
+      index = records.size();
+      // Index 0xFFFFFF is left out, so no handle can equal BT_NULL_ENTITY
+      if (index >= ENTITY_INDEX_MASK)
+      {
+        Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
+        BT_TRACE_TO(trace, 0, "Too many entities!");
+        return BT_NULL_ENTITY;
+      }
+      Record record = { nullptr, 0, 0 };
+      records.push_back(record);
+    }
+    Record &record = records[index];
+    Entity entity = index | (record.generation << ENTITY_GENERATION_SHIFT);
+    record.archetype = empty;
+    record.row = PushRow(empty, entity);
+    ++living;
+    return entity;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Destroys an entity. Its handle stops being alive and its index is
+  reused with a new generation.
+
+  \param entity
+  Entity to destroy.
+  */
+  /*****************************************/
+  void ECS::Destroy(Entity entity)
+  {
+    if (!Alive(entity)) return;
+    unsigned index = entity & ENTITY_INDEX_MASK;
+    Record &record = records[index];
+    RemoveRow(record.archetype, record.row);
+    record.archetype = nullptr;
+    record.generation = (record.generation + 1) & 0xFF;
+    freeindices.push_back(index);
+    --living;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Determines if an entity handle refers to a living entity.
+  */
+  /*****************************************/
+  bool ECS::Alive(Entity entity) const
+  {
+    unsigned index = entity & ENTITY_INDEX_MASK;
+    if (index >= records.size()) return false;
+    const Record &record = records[index];
+    return record.archetype &&
+      record.generation == (entity >> ENTITY_GENERATION_SHIFT);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets the cached query for a set of components.
+
+  \param include
+  Bit per ComponentID an archetype must have.
+
+  \param exclude
+  Bit per ComponentID an archetype must not have.
+
+  \return
+  Reference to the query, valid for the life of the ECS.
+  */
+  /*****************************************/
+  ECS::Query &ECS::GetQuery(uint64_t include, uint64_t exclude)
+  {
+    for (auto it : queries)
+      if (it->include == include && it->exclude == exclude) return *it;
+
+    Query *query = new Query;
+    query->include = include;
+    query->exclude = exclude;
+    for (auto &it : archetypes)
+    {
+      uint64_t mask = it.second->mask;
+      if ((mask & include) == include && !(mask & exclude))
+        query->archetypes.push_back(it.second);
+    }
+    queries.push_back(query);
+    return *query;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gives out the next ComponentID. Called when Component<T>::id is set.
+
+  \param size
+  Size of the component.
+
+  \param align
+  Alignment of the component.
+  */
+  /*****************************************/
+  ComponentID ECS::RegisterComponent(size_t size, size_t align)
+  {
+    ComponentID id = componentcount++;
+    if (id < BT_MAX_COMPONENTS)
+    {
+      componentsizes[id] = size;
+      componentaligns[id] = align;
+    }
+    return id;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Moves an entity to the archetype with one more component.
+
+  \return
+  Pointer to the (uninitialized) component, nullptr on failure.
+  */
+  /*****************************************/
+  void *ECS::AddRaw(Entity entity, ComponentID id)
+  {
+    if (!Alive(entity)) return nullptr;
+    if (id >= BT_MAX_COMPONENTS)
+    {
+      Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
+      BT_TRACE_TO(
+        trace, 0, "Too many component types! Raise BT_MAX_COMPONENTS"
+      );
+      return nullptr;
+    }
+    Record &record = records[entity & ENTITY_INDEX_MASK];
+    Archetype *arch = record.archetype;
+    if (!(arch->mask & (uint64_t(1) << id)))
+    {
+      if (!arch->addedge[id])
+      {
+        Archetype *target = GetArchetype(arch->mask | (uint64_t(1) << id));
+        arch->addedge[id] = target;
+        target->removeedge[id] = arch;
+      }
+      Move(entity, arch->addedge[id]);
+    }
+    return Cell(record.archetype, record.row, id);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Moves an entity to the archetype with one less component.
+  */
+  /*****************************************/
+  void ECS::RemoveRaw(Entity entity, ComponentID id)
+  {
+    if (!Alive(entity) || id >= BT_MAX_COMPONENTS) return;
+    Archetype *arch = records[entity & ENTITY_INDEX_MASK].archetype;
+    if (!(arch->mask & (uint64_t(1) << id))) return;
+    if (!arch->removeedge[id])
+    {
+      Archetype *target = GetArchetype(arch->mask & ~(uint64_t(1) << id));
+      arch->removeedge[id] = target;
+      target->addedge[id] = arch;
+    }
+    Move(entity, arch->removeedge[id]);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets a pointer to an entity's component, nullptr if it has none.
+  */
+  /*****************************************/
+  void *ECS::GetRaw(Entity entity, ComponentID id)
+  {
+    if (!Alive(entity) || id >= BT_MAX_COMPONENTS) return nullptr;
+    Record &record = records[entity & ENTITY_INDEX_MASK];
+    if (!(record.archetype->mask & (uint64_t(1) << id))) return nullptr;
+    return Cell(record.archetype, record.row, id);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets the archetype with a mask, creating it (and updating the cached
+  queries) if it doesn't exist yet.
+  */
+  /*****************************************/
+  ECS::Archetype *ECS::GetArchetype(uint64_t mask)
+  {
+    auto found = archetypes.find(mask);
+    if (found != archetypes.end()) return found->second;
+
+    Archetype *arch = new Archetype;
+    arch->mask = mask;
+    arch->count = 0;
+    size_t rowsize = sizeof(Entity);
+    size_t padding = 0;
+    for (ComponentID i = 0; i < BT_MAX_COMPONENTS; ++i)
+    {
+      arch->offsets[i] = 0;
+      arch->addedge[i] = arch->removeedge[i] = nullptr;
+      if (!(mask & (uint64_t(1) << i))) continue;
+      rowsize += componentsizes[i];
+      padding += componentaligns[i] - 1;
+    }
+    // Leave room to align each column. Huge rows get a chunk to themselves
+    arch->capacity = (BT_ECS_CHUNK_SIZE > padding) ?
+      (BT_ECS_CHUNK_SIZE - padding) / rowsize : 0;
+    if (!arch->capacity) arch->capacity = 1;
+
+    size_t offset = sizeof(Entity) * arch->capacity;
+    for (ComponentID i = 0; i < BT_MAX_COMPONENTS; ++i)
+    {
+      if (!(mask & (uint64_t(1) << i))) continue;
+      size_t align = componentaligns[i];
+      offset = (offset + align - 1) / align * align;
+      arch->offsets[i] = offset;
+      offset += componentsizes[i] * arch->capacity;
+    }
+    arch->chunksize = (offset > BT_ECS_CHUNK_SIZE) ? offset : BT_ECS_CHUNK_SIZE;
+    archetypes[mask] = arch;
+
+    for (auto it : queries)
+      if ((mask & it->include) == it->include && !(mask & it->exclude))
+        it->archetypes.push_back(arch);
+    return arch;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Appends an entity to an archetype, adding a chunk if needed.
+
+  \return
+  Row of the entity. Its components are left uninitialized.
+  */
+  /*****************************************/
+  unsigned ECS::PushRow(Archetype *arch, Entity entity)
+  {
+    unsigned row = arch->count++;
+    unsigned index = row / arch->capacity;
+    if (index == arch->chunks.size())
+    {
+      Chunk *chunk = new Chunk;
+      chunk->data = new char[arch->chunksize];
+      chunk->count = 0;
+      chunk->archetype = arch;
+      arch->chunks.push_back(chunk);
+    }
+    Chunk *chunk = arch->chunks[index];
+    chunk->Entities()[chunk->count++] = entity;
+    return row;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Removes a row from an archetype by moving the last row into it.
+  */
+  /*****************************************/
+  void ECS::RemoveRow(Archetype *arch, unsigned row)
+  {
+    unsigned last = --arch->count;
+    Chunk *lastchunk = arch->chunks[last / arch->capacity];
+    --lastchunk->count;
+    if (row == last) return;
+
+    Chunk *chunk = arch->chunks[row / arch->capacity];
+    Entity moved = lastchunk->Entities()[last % arch->capacity];
+    chunk->Entities()[row % arch->capacity] = moved;
+    for (ComponentID i = 0; i < BT_MAX_COMPONENTS; ++i)
+      if (arch->mask & (uint64_t(1) << i))
+        memcpy(Cell(arch, row, i), Cell(arch, last, i), componentsizes[i]);
+    records[moved & ENTITY_INDEX_MASK].row = row;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Moves an entity to another archetype, keeping the components both have.
+  */
+  /*****************************************/
+  void ECS::Move(Entity entity, Archetype *target)
+  {
+    Record &record = records[entity & ENTITY_INDEX_MASK];
+    Archetype *source = record.archetype;
+    unsigned row = PushRow(target, entity);
+    uint64_t shared = source->mask & target->mask;
+    for (ComponentID i = 0; i < BT_MAX_COMPONENTS; ++i)
+    {
+      if (shared & (uint64_t(1) << i))
+        memcpy(
+          Cell(target, row, i), Cell(source, record.row, i), componentsizes[i]
+        );
+    }
+    RemoveRow(source, record.row);
+    record.archetype = target;
+    record.row = row;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets the address of a row's component.
+  */
+  /*****************************************/
+  char *ECS::Cell(Archetype *arch, unsigned row, ComponentID id)
+  {
+    Chunk *chunk = arch->chunks[row / arch->capacity];
+    return chunk->data + arch->offsets[id] +
+      (row % arch->capacity) * componentsizes[id];
+  }
+}
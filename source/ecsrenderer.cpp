@@ -0,0 +1,75 @@
+/******************************************************************************/
+/*!
+\file ecsrenderer.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Components and system for drawing ECS entities through Graphics.
+*/
+/******************************************************************************/
+#include "brewtools/ecsrenderer.h" // ECSRenderer class
+#include "brewtools/trace.h"       // Trace class
+#include "brewtools/zones.h"       // BT_ZONE
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  /*****************************************/
+  /*!
+  \brief
+  Default constructor.
+  */
+  /*****************************************/
+  ECSRenderer::ECSRenderer() : drawn(0)
+  {
+    // Drawing binds the graphics context, which is thread bound
+    Reads<ECS>();
+    Writes<Graphics>();
+    Writes<Trace>();
+    SetMainThreadOnly();
+    SetPhase(PHASE_RENDER);
+    Engine::Get()->GetProfile().SetName(id, "ECSRenderer");
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Draws the entities.
+  */
+  /*****************************************/
+  void ECSRenderer::Update()
+  {
+    BT_ZONE("ECSRenderer::Update");
+    drawn = 0;
+    ECS *ecs = Engine::Get()->GetSystemIfExists<ECS>();
+    if (!ecs) return;
+    unsigned &count = drawn;
+    ecs->ForEachChunk<Transform, ColorMesh>(
+      [&count](unsigned n, Entity *, Transform *t, ColorMesh *m) {
+        for (unsigned i = 0; i < n; ++i)
+        {
+          Graphics::Shape *shape = m[i].shape;
+          if (!shape) continue;
+          shape->position.x = t[i].x;
+          shape->position.y = t[i].y;
+          shape->position.z = t[i].z;
+          shape->rotation = t[i].rotation;
+          shape->scale.x = t[i].scalex;
+          shape->scale.y = t[i].scaley;
+          shape->Draw();
+          ++count;
+        }
+      }
+    );
+  }
+}
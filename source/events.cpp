@@ -0,0 +1,88 @@
+/******************************************************************************/
+/*!
+\file events.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Typed event bus dispatched by the Engine between update phases.
+*/
+/******************************************************************************/
+#include "brewtools/events.h" // EventBus class
+
+#ifndef BT_NO_THREADS
+#include <atomic> // std::atomic
+#endif
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  #ifndef BT_NO_THREADS
+  //! Total number of EventTypeIDs
+  static std::atomic<EventTypeID> eventtypecount(0);
+  #else
+  static EventTypeID eventtypecount; //!< Total number of EventTypeIDs
+  #endif
+
+  /*****************************************/
+  /*!
+  \brief
+  Default constructor.
+  */
+  /*****************************************/
+  EventBus::EventBus() : lasthandle(0)
+  {
+    for (EventTypeID i = 0; i < BT_MAX_EVENT_TYPES; ++i)
+      channels[i] = nullptr;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Destructor. Drops undelivered events.
+  */
+  /*****************************************/
+  EventBus::~EventBus()
+  {
+    for (EventTypeID i = 0; i < BT_MAX_EVENT_TYPES; ++i)
+    {
+      ChannelBase *channel = channels[i];
+      delete channel;
+    }
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Delivers every queued event to its subscribers.
+  */
+  /*****************************************/
+  void EventBus::Dispatch()
+  {
+    for (EventTypeID i = 0; i < BT_MAX_EVENT_TYPES; ++i)
+    {
+      ChannelBase *channel = channels[i];
+      if (channel) channel->Dispatch();
+    }
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gives out the next EventTypeID. Called when Type<T>::id is set.
+  */
+  /*****************************************/
+  EventTypeID EventBus::RegisterType()
+  {
+    return eventtypecount++;
+  }
+}
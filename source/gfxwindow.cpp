@@ -19,6 +19,7 @@ Window for displaying graphics using OpenGL.
 #include "brewtools/trace.h"
 #include "brewtools/graphics.h"
 #include "brewtools/time.h"
+#include "brewtools/zones.h"
 #ifdef _WIN32 //The following only exists in a Windows build
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -51,6 +52,8 @@ Height of viewport.
 void windows_fbsc(GLFWwindow* window, int width, int height)
 {
   glViewport(0, 0, width, height);
+  BrewTools::WindowResizeEvent resize = { width, height };
+  BrewTools::Engine::Get()->GetRecorder().Input(resize);
 }
 #endif //_WIN32
 
@@ -80,8 +83,7 @@ namespace BrewTools
       frameStarted(false)
   {
     Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
-    if (trace)
-      (*trace)[6] << "  Creating GFXWindow...";
+    BT_TRACE_TO(trace, 6, "  Creating GFXWindow...");
     Time *t;
     if ((t = Engine::Get()->GetSystemIfExists<Time>()))
       lasttime = t->Current();
@@ -92,8 +94,7 @@ namespace BrewTools
     if (gfx)
       cwin = gfx->GetCurrentWindow();
     #ifdef _WIN32 //The following only exists in a Windows build
-    if (trace)
-      (*trace)[7] << "    Creating glfw window...";
+    BT_TRACE_TO(trace, 7, "    Creating glfw window...");
     glfwwindow = glfwCreateWindow(
       DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT,
       name.c_str(),
@@ -102,22 +103,18 @@ namespace BrewTools
     selected = true;
     if (!glfwwindow)
     {
-      if (trace)
-        (*trace)[6] << "  Failed to create glfw window";
+      BT_TRACE_TO(trace, 6, "  Failed to create glfw window");
       return;
     }
 
-    if (trace)
-      (*trace)[7] << "    Setting FBSC...";
+    BT_TRACE_TO(trace, 7, "    Setting FBSC...");
     glfwMakeContextCurrent(glfwwindow);
     glfwSetFramebufferSizeCallback(glfwwindow, windows_fbsc);
 
-    if (trace)
-      (*trace)[7] << "    Loading GLAD...";
+    BT_TRACE_TO(trace, 7, "    Loading GLAD...");
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
     {
-      if (trace)
-        (*trace)[6] << "  Failed to initialize GLAD";
+      BT_TRACE_TO(trace, 6, "  Failed to initialize GLAD");
       return;
     }
     if (cwin)
@@ -143,10 +140,11 @@ namespace BrewTools
       selected = false;
       C3D_FrameDrawOn(cwin->GetTarget());
     }
+    #else
+    (void)cwin; // Headless host builds have no context to switch back to
     #endif
     Clear();
-    if (trace)
-      (*trace)[6] << "  Created GFXWindow!";
+    BT_TRACE_TO(trace, 6, "  Created GFXWindow!");
   }
   
   /*****************************************/
@@ -209,12 +207,14 @@ namespace BrewTools
       glfwSetFramebufferSizeCallback(glfwwindow, windows_fbsc);
       
       Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
-      Graphics *g = Engine::Get()->GetSystem<Graphics>();
-      g->SelectWindow(this);
+      // Graphics' constructor adds windows, so it's never created from here
+      Graphics *g = Engine::Get()->GetSystemIfExists<Graphics>();
+      if (g) g->SelectWindow(this);
+      else glfwMakeContextCurrent(glfwwindow);
       
       if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
       {
-        if (trace) (*trace)[0] << "Failed to initialize GLAD";
+        BT_TRACE_TO(trace, 0, "Failed to initialize GLAD");
       }
     }
     #endif
@@ -231,15 +231,16 @@ namespace BrewTools
   /*****************************************/
   void GFXWindow::Update()
   {
+    BT_ZONE("GFXWindow::Update");
     BrewTools::Trace *trace =
         BrewTools::Engine::Get()->GetSystemIfExists<BrewTools::Trace>();
-    if (trace) (*trace)[8] << "      Updating GFXWindow...";
+    BT_TRACE_TO(trace, 8, "      Updating GFXWindow...");
     #ifdef _WIN32
     EndFrame();
     StartFrame();
     #endif
     UpdateDT();
-    if (trace) (*trace)[8] << "      GFXWindow updated!";
+    BT_TRACE_TO(trace, 8, "      GFXWindow updated!");
   }
   
   /*****************************************/
@@ -252,7 +253,7 @@ namespace BrewTools
   {
     BrewTools::Trace *trace =
         BrewTools::Engine::Get()->GetSystemIfExists<BrewTools::Trace>();
-    if (trace) (*trace)[9] << "        Clearing...";
+    BT_TRACE_TO(trace, 9, "        Clearing...");
     #ifdef _3DS
     // TODO: Look into clearing the screen on 3DS
     #elif _WIN32
@@ -264,7 +265,7 @@ namespace BrewTools
     );
     glClear(GL_COLOR_BUFFER_BIT);
     #endif
-    if (trace) (*trace)[9] << "        Cleared!";
+    BT_TRACE_TO(trace, 9, "        Cleared!");
   }
   
   /*****************************************/
@@ -275,16 +276,17 @@ namespace BrewTools
   /*****************************************/
   void GFXWindow::SwapBuffers()
   {
+    BT_ZONE("GFXWindow::SwapBuffers");
     BrewTools::Trace *trace =
         BrewTools::Engine::Get()->GetSystemIfExists<BrewTools::Trace>();
-    if (trace) (*trace)[9] << "        Swapping buffers...";
+    BT_TRACE_TO(trace, 9, "        Swapping buffers...");
     #ifdef _3DS
 
     #elif _WIN32
     glfwSwapBuffers(glfwwindow);
     glfwPollEvents();
     #endif
-    if (trace) (*trace)[9] << "        Buffers swapped!";
+    BT_TRACE_TO(trace, 9, "        Buffers swapped!");
   }
   
   /*****************************************/
@@ -318,8 +320,9 @@ namespace BrewTools
     {
       BrewTools::Trace *trace =
           BrewTools::Engine::Get()->GetSystemIfExists<BrewTools::Trace>();
-      if (trace)
-        (*trace)[7] << "  GFXWindow can't start frame as one is in progress!";
+      BT_TRACE_TO(
+        trace, 7, "  GFXWindow can't start frame as one is in progress!"
+      );
     }
     frameStarted = true;
     return true;
@@ -340,8 +343,9 @@ namespace BrewTools
     {
       BrewTools::Trace *trace =
           BrewTools::Engine::Get()->GetSystemIfExists<BrewTools::Trace>();
-      if (trace)
-        (*trace)[7] << "  GFXWindow can't end frame as none have started!";
+      BT_TRACE_TO(
+        trace, 7, "  GFXWindow can't end frame as none have started!"
+      );
       return false;
     }
     #ifdef _3DS //The following only exists in a 3DS build
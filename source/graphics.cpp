@@ -17,8 +17,11 @@ Graphics management and implementation.
 #include "brewtools/graphics.h"
 #include "brewtools/window.h"
 #include "brewtools/macros.h"
+#include "brewtools/time.h"
+#include "brewtools/zones.h"
 
 #include <iostream>
+#include <memory> // std::uninitialized_copy
 
 #ifdef _3DS //The following only exists in a 3DS build
 #include <3ds.h>
@@ -61,6 +64,8 @@ Height of viewport.
 void _framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
   glViewport(0, 0, width, height);
+  BrewTools::WindowResizeEvent resize = { width, height };
+  BrewTools::Engine::Get()->GetRecorder().Input(resize);
 }
 #endif //_WIN32
 
@@ -859,15 +864,25 @@ namespace BrewTools
   /*****************************************/
   void Graphics::Shape::BufferColor()
   {
-    vc.resize(vertc.size());
-    memcpy(vc.data(), vertc.data(), vertc.size() * sizeof(vertex_col));
+    BT_ZONE("Shape::BufferColor");
+    // Scratch copy lives in the frame arena, so steady frames don't allocate
+    vertex_col *vc = Engine::Get()->GetFrameArena().Allocate<vertex_col>(
+      vertc.size()
+    );
+    std::uninitialized_copy(vertc.begin(), vertc.end(), vc);
 
-    for (unsigned i = 0; i < vc.size(); ++i)
-    {
-      vc[i].pos.x += position.x;
-      vc[i].pos.y += position.y;
-      vc[i].pos.z += position.z;
-    }
+    // Large shapes are offset in parallel chunks on the job system
+    Engine::Get()->GetJobs().ParallelFor(
+      0, vertc.size(), BT_SHAPE_PREP_GRAIN,
+      [this, vc](unsigned begin, unsigned end) {
+        for (unsigned i = begin; i < end; ++i)
+        {
+          vc[i].pos.x += position.x;
+          vc[i].pos.y += position.y;
+          vc[i].pos.z += position.z;
+        }
+      }
+    );
 
     #ifdef _3DS //The following only exists in a 3DS build
     C3D_ImmDrawBegin(GPU_TRIANGLES);
@@ -889,7 +904,7 @@ namespace BrewTools
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(
       GL_ARRAY_BUFFER,
-      vertc.size() * sizeof(vertex_col), vc.data(),
+      vertc.size() * sizeof(vertex_col), vc,
       GL_STATIC_DRAW
     );
     
@@ -927,41 +942,49 @@ namespace BrewTools
   /*****************************************/
   void Graphics::Shape::Draw()
   {
+    BT_ZONE("Shape::Draw");
     Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
     Graphics *g;
-    if (trace) (*trace)[6] << "  Drawing shape...";
+    BT_TRACE_TO(trace, 6, "  Drawing shape...");
     if (!(g = Engine::Get()->GetSystemIfExists<Graphics>())) 
     {
-      if (trace) (*trace)[0] << "Couldn't draw! No graphics system!";
+      BT_TRACE_TO(trace, 0, "Couldn't draw! No graphics system!");
       return;
     }
     if (vertt.empty() && vertc.empty())
     {
-      if (trace) (*trace)[0] << "Couldn't draw! No color or texture vertices!";
+      BT_TRACE_TO(trace, 0, "Couldn't draw! No color or texture vertices!");
+      return;
+    }
+    ++g->draws;
+    g->vertices += vertc.size(); // Texture drawing isn't implemented yet
+    if (g->headless)
+    {
+      BT_TRACE_TO(trace, 6, "  Shape counted (headless)!");
       return;
     }
     if (!vertt.empty())
     {
-      if (trace) (*trace)[7] << "    Drawing Textures...";
+      BT_TRACE_TO(trace, 7, "    Drawing Textures...");
       // TODO: Draw textures
-      if (trace) (*trace)[7] << "    Textures drawn!";
+      BT_TRACE_TO(trace, 7, "    Textures drawn!");
     }
     if (!vertc.empty())
     {
-      if (trace) (*trace)[7] << "    Drawing Colors...";
+      BT_TRACE_TO(trace, 7, "    Drawing Colors...");
       #ifdef _3DS //The following only exists in a 3DS build
-      //if (trace) (*trace)[8] << "      Preparing projection matrix...";
+      //BT_TRACE_TO(trace, 8, "      Preparing projection matrix...");
       //C3D_FVUnifMtx4x4(GPU_VERTEX_SHADER, g->uLoc_projection, &g->projection);
       #endif
-      if (trace) (*trace)[8] << "      Buffering colors...";
+      BT_TRACE_TO(trace, 8, "      Buffering colors...");
       BufferColor();
       #ifdef _WIN32 //The following only exists in a Windows build
-      if (trace) (*trace)[8] << "      Selecting program...";
+      BT_TRACE_TO(trace, 8, "      Selecting program...");
       int shaderProgram = g->GetProgram();
       unsigned VAO = g->GetVAO();
       glUseProgram(shaderProgram);
       glBindVertexArray(VAO);
-      if (trace) (*trace)[8] << "      Drawing elements...";
+      BT_TRACE_TO(trace, 8, "      Drawing elements...");
       glDrawElements(GL_TRIANGLES, indice.size(), GL_UNSIGNED_INT, 0);
       
       glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -986,9 +1009,9 @@ namespace BrewTools
       //std::cout << "\nVAO: " << VAO << "\nVBO: " << VBO <<
       //"\nEBO: " << EBO << std::endl;
       #endif
-      if (trace) (*trace)[7] << "    Colors drawn!";
+      BT_TRACE_TO(trace, 7, "    Colors drawn!");
     }
-    if (trace) (*trace)[6] << "  Shape drawn!";
+    BT_TRACE_TO(trace, 6, "  Shape drawn!");
   }
 
   /****************************************************************************/
@@ -1013,40 +1036,53 @@ namespace BrewTools
   {
     BrewTools::Trace *trace =
       BrewTools::Engine::Get()->GetSystemIfExists<BrewTools::Trace>();
-    if (trace) (*trace)[5] << "Creating Graphics...";
+    BT_TRACE_TO(trace, 5, "Creating Graphics...");
+    // Windows trace and read Time for their DT. The context is thread bound
+    Writes<Trace>();
+    Reads<Time>();
+    SetMainThreadOnly();
+    SetPhase(PHASE_PRESENT);
+    BrewTools::Engine::Get()->GetProfile().SetName(id, "Graphics");
+    headless = BrewTools::Engine::Get()->IsHeadless();
+    draws = vertices = lastdraws = lastvertices = 0;
+    if (headless)
+    {
+      BT_TRACE_TO(trace, 5, "Graphics created headless!");
+      return;
+    }
     #ifdef _3DS //The following only exists in a 3DS build
-    if (trace) (*trace)[6] << "  Initializing gfx default...";
+    BT_TRACE_TO(trace, 6, "  Initializing gfx default...");
     gfxInitDefault();
     //gfxSet3D(false);
-    if (trace) (*trace)[6] << "  Initializing C3D...";
+    BT_TRACE_TO(trace, 6, "  Initializing C3D...");
     C3D_Init(C3D_DEFAULT_CMDBUF_SIZE);
 
     // TODO: Investigate this. Maybe it should be uncommented
     C3D_CullFace(GPU_CULL_NONE);
     C3D_DepthTest(true, GPU_GEQUAL, GPU_WRITE_ALL);
     #elif _WIN32 //The following only exists in a Windows build
-    if (trace) (*trace)[6] << "  Initializing GLFW...";
+    BT_TRACE_TO(trace, 6, "  Initializing GLFW...");
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
     #endif
-    if (trace) (*trace)[6] << "  Adding GFXWindow...";
+    BT_TRACE_TO(trace, 6, "  Adding GFXWindow...");
     AddWindow(
       new BrewTools::GFXWindow("BrewTools", Window::Screen::TOP)
     );
     #ifdef _3DS //The following only exists in a 3DS build
-    if (trace) (*trace)[6] << "  Running 3DS GFX initialization...";
+    BT_TRACE_TO(trace, 6, "  Running 3DS GFX initialization...");
     Init3DS();
     #endif
     SelectWindow(unsigned(0));
     #ifdef _WIN32 //The following only exists in a Windows build
-    if (trace) (*trace)[6] << "  Generating buffers...";
+    BT_TRACE_TO(trace, 6, "  Generating buffers...");
     GenBuffers();
     LoadShader();
     #endif
-    if (trace) (*trace)[5] << "Graphics created!";
+    BT_TRACE_TO(trace, 5, "Graphics created!");
   }
 
   /*****************************************/
@@ -1059,9 +1095,14 @@ namespace BrewTools
   {
     BrewTools::Trace *trace =
         BrewTools::Engine::Get()->GetSystemIfExists<BrewTools::Trace>();
-    if (trace) (*trace)[5] << "Shutting down graphics...";
+    BT_TRACE_TO(trace, 5, "Shutting down graphics...");
     for (auto it : windows)
       delete it;
+    if (headless)
+    {
+      BT_TRACE_TO(trace, 5, "Graphics shut down!");
+      return;
+    }
     #ifdef _3DS //The following only exists in a 3DS build
     Exit3DS();
     C3D_Fini();
@@ -1072,7 +1113,7 @@ namespace BrewTools
     glDeleteBuffers(1, &EBO);
     glfwTerminate();
     #endif
-    if (trace) (*trace)[5] << "Graphics shut down!";
+    BT_TRACE_TO(trace, 5, "Graphics shut down!");
   }
 
   /*****************************************/
@@ -1090,74 +1131,72 @@ namespace BrewTools
   /*****************************************/
   void Graphics::Update()
   {
+    BT_ZONE("Graphics::Update");
     BrewTools::Trace *trace =
         BrewTools::Engine::Get()->GetSystemIfExists<BrewTools::Trace>();
-    if (trace)
-      (*trace)[6] << "  Updating Graphics...";
+    BT_TRACE_TO(trace, 6, "  Updating Graphics...");
+    lastdraws = draws;
+    lastvertices = vertices;
+    draws = vertices = 0;
+    if (headless)
+    {
+      BT_TRACE_TO(trace, 6, "  Graphics updated!");
+      return;
+    }
     bool selectedinlist(false);
-    if (trace)
-      (*trace)[7] << "    Updating Windows...";
+    BT_TRACE_TO(trace, 7, "    Updating Windows...");
     for (auto it : windows)
     {
       it->Update();
       if (it == currentwindow) selectedinlist = true;
     }
-    if (trace)
-      (*trace)[7] << "    Windows updated!";
+    BT_TRACE_TO(trace, 7, "    Windows updated!");
     if (!selectedinlist && currentwindow)
     {
-      if (trace)
-        (*trace)[7] << "    Selected window not in the list. Updating it...";
+      BT_TRACE_TO(
+        trace, 7, "    Selected window not in the list. Updating it..."
+      );
       currentwindow->Update();
-      if (trace)
-        (*trace)[7] << "    Selected window updated!";
+      BT_TRACE_TO(trace, 7, "    Selected window updated!");
     }
 
     #ifdef _3DS
     // End the frame if one has been started
     if (frameStarted)
     {
-      if (trace)
-        (*trace)[7] << "    Ending frame...";
+      BT_TRACE_TO(trace, 7, "    Ending frame...");
       C3D_FrameEnd(0);
-      if (trace)
-        (*trace)[7] << "    Frame ended!";
+      BT_TRACE_TO(trace, 7, "    Frame ended!");
       frameStarted = false;
     }
     else
     {
-      if (trace)
-        (*trace)[7] << "    Couldn't end frame! None in progress";
+      BT_TRACE_TO(trace, 7, "    Couldn't end frame! None in progress");
     }
     
     // Start a new frame if none are in progress
     if (!frameStarted)
     {
-      if (trace)
-        (*trace)[7] << "    Starting frame...";
+      BT_TRACE_TO(trace, 7, "    Starting frame...");
       if (currentwindow)
       {
         C3D_FrameBegin(C3D_FRAME_SYNCDRAW);
         C3D_FrameDrawOn(currentwindow->GetTarget());
-        if (trace)
-          (*trace)[7] << "    Frame Started...";
+        BT_TRACE_TO(trace, 7, "    Frame Started...");
       }
       else
       {
-        if (trace)
-          (*trace)[7] << "    Couldn't start frame! No currentwindow";
+        BT_TRACE_TO(trace, 7, "    Couldn't start frame! No currentwindow");
       }
       frameStarted = true;
     }
     else
     {
-      if (trace)
-        (*trace)[7] << "    Couldn't start frame! One in progress";
+      BT_TRACE_TO(trace, 7, "    Couldn't start frame! One in progress");
     }
     #endif
 
-    if (trace)
-      (*trace)[6] << "  Graphics updated!";
+    BT_TRACE_TO(trace, 6, "  Graphics updated!");
   }
   
   /*****************************************/
@@ -1172,20 +1211,18 @@ namespace BrewTools
   unsigned Graphics::AddWindow(GFXWindow *window)
   {
     Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
-    if (trace)
-      (*trace)[6] << "  Adding GFXWindow to Graphics...";
+    BT_TRACE_TO(trace, 6, "  Adding GFXWindow to Graphics...");
     if (window->parent)
     {
-      if (trace)
-        (*trace)[7] << "    Window has an existing parent. Removing it...";
+      BT_TRACE_TO(
+        trace, 7, "    Window has an existing parent. Removing it..."
+      );
       ((Graphics*)(window->parent))->RemoveWindow(window);
     }
-    if (trace)
-      (*trace)[7] << "    Setting parent...";
+    BT_TRACE_TO(trace, 7, "    Setting parent...");
     window->parent = this;
     windows.push_back(window);
-    if (trace)
-      (*trace)[6] << "  Window added!";
+    BT_TRACE_TO(trace, 6, "  Window added!");
     return windows.size();
   }
   
@@ -1285,11 +1322,11 @@ namespace BrewTools
   {
     Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
     #ifdef _WIN32 // The following only exists in a Windows build
-    if (trace) (*trace)[5] << "Loading shaders..." << std::endl;
+    BT_TRACE_TO(trace, 5, "Loading shaders...");
     int vertexShader = glCreateShader(GL_VERTEX_SHADER);
     // If a vertex shader was given, use it as the source
     // If none was given, use the default one
-    if (trace) (*trace)[6] << "  Compiling Vertex Shader..." << std::endl;
+    BT_TRACE_TO(trace, 6, "  Compiling Vertex Shader...");
     if (vs && vs[0]) glShaderSource(vertexShader, 1, &vs, nullptr);
     else glShaderSource(vertexShader, 1, &DefaultVSSource, nullptr);
     glCompileShader(vertexShader);
@@ -1300,10 +1337,13 @@ namespace BrewTools
     if (!success)
     {
       glGetShaderInfoLog(vertexShader, 512, nullptr, infoLog);
-      if (trace) (*trace)[0] << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+      BT_TRACE_TO(
+        trace, 0,
+        "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog
+      );
     }
-    else if (trace) (*trace)[6] << "  Vertex Shader Compiled!" << std::endl;
-    if (trace) (*trace)[6] << "  Compiling Fragment Shader..." << std::endl;
+    else BT_TRACE_TO(trace, 6, "  Vertex Shader Compiled!");
+    BT_TRACE_TO(trace, 6, "  Compiling Fragment Shader...");
     // fragment shader
     int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
     // If a fragment shader was given, use it as the source
@@ -1316,10 +1356,13 @@ namespace BrewTools
     if (!success)
     {
       glGetShaderInfoLog(fragmentShader, 512, nullptr, infoLog);
-      if (trace) (*trace)[0] << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+      BT_TRACE_TO(
+        trace, 0,
+        "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog
+      );
     }
-    else if (trace) (*trace)[6] << "  Fragment Shader Compiled!" << std::endl;
-    if (trace) (*trace)[6] << "  Linking shaders..." << std::endl;
+    else BT_TRACE_TO(trace, 6, "  Fragment Shader Compiled!");
+    BT_TRACE_TO(trace, 6, "  Linking shaders...");
     // link shaders
     shaderProgram = glCreateProgram();
     glAttachShader(shaderProgram, vertexShader);
@@ -1329,21 +1372,23 @@ namespace BrewTools
     glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
     if (!success) {
       glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
-      if (trace) (*trace)[0] << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+      BT_TRACE_TO(
+        trace, 0,
+        "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog
+      );
     }
-    else if (trace) (*trace)[6] << "  Shaders linked!" << std::endl;
-    if (trace) (*trace)[6] << "  Cleaning up..." << std::endl;
+    else BT_TRACE_TO(trace, 6, "  Shaders linked!");
+    BT_TRACE_TO(trace, 6, "  Cleaning up...");
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
     
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
-    if (trace) (*trace)[5] << "Shaders loaded!" << std::endl;
+    BT_TRACE_TO(trace, 5, "Shaders loaded!");
     return shaderProgram;
-    #elif _3DS // The following only exists in a 3DS build
-      if (trace)
-        (*trace)[5] << "Graphics::LoadShader() only works on Windows";
+    #else // The following exists in every other build
+      BT_TRACE_TO(trace, 5, "Graphics::LoadShader() only works on Windows");
     return 0;
     #endif
   }
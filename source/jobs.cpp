@@ -0,0 +1,431 @@
+/******************************************************************************/
+/*!
+\file jobs.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Work-stealing job system owned by the Engine.
+*/
+/******************************************************************************/
+#include "brewtools/jobs.h"       // JobSystem class
+#include "brewtools/distillery.h" // Engine class
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  #ifndef BT_NO_THREADS
+  //! Queue index of the current thread. 0 is the shared queue
+  static thread_local unsigned workerindex = 0;
+  //! Job system the current thread is a worker of
+  static thread_local JobSystem *workerowner = nullptr;
+  #endif
+
+  /****************************************************************************/
+  /*
+  TASK GROUP
+  */
+  /****************************************************************************/
+
+  /*****************************************/
+  /*!
+  \brief
+  Default constructor.
+
+  \param jobs
+  Job system to run on. nullptr uses the Engine's job system.
+  */
+  /*****************************************/
+  TaskGroup::TaskGroup(JobSystem *jobs)
+    : jobs(jobs ? jobs : &Engine::Get()->GetJobs()), closed(false), count(1),
+      done(false)
+  {}
+
+  /*****************************************/
+  /*!
+  \brief
+  Destructor. Waits for all jobs in the group.
+  */
+  /*****************************************/
+  TaskGroup::~TaskGroup()
+  {
+    Wait();
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Adds a job to the group.
+
+  \param func
+  Function to run.
+  */
+  /*****************************************/
+  void TaskGroup::Run(std::function<void()> func)
+  {
+    ++count;
+    JobSystem::Job job = { func, this, false };
+    jobs->Push(job);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Closes the group and sets a job to run once all of its jobs finish.
+
+  \param func
+  Function to run after the group's jobs.
+  */
+  /*****************************************/
+  void TaskGroup::Then(std::function<void()> func)
+  {
+    if (closed) return;
+    continuation = func;
+    closed = true;
+    Release();
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Closes the group and runs other jobs until it is done.
+  */
+  /*****************************************/
+  void TaskGroup::Wait()
+  {
+    if (!closed)
+    {
+      closed = true;
+      Release();
+    }
+    while (!Done())
+    {
+      #ifndef BT_NO_THREADS
+      if (!jobs->TryRunOne()) std::this_thread::yield();
+      #endif
+    }
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Determines if every job (and the continuation) has finished.
+  */
+  /*****************************************/
+  bool TaskGroup::Done() const
+  {
+    return done;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Drops a reference to the group, scheduling the continuation or marking
+  the group done when the last one goes.
+  */
+  /*****************************************/
+  void TaskGroup::Release()
+  {
+    if (--count) return;
+    if (continuation)
+    {
+      JobSystem::Job job = { continuation, this, true };
+      continuation = nullptr;
+      jobs->Push(job);
+    }
+    else
+      done = true;
+  }
+
+  /****************************************************************************/
+  /*
+  JOB SYSTEM
+  */
+  /****************************************************************************/
+
+  /*****************************************/
+  /*!
+  \brief
+  Default constructor. Starts with no workers.
+  */
+  /*****************************************/
+  JobSystem::JobSystem()
+  #ifndef BT_NO_THREADS
+    : queued(0), stopping(false)
+  #endif
+  {
+    #ifndef BT_NO_THREADS
+    queues.push_back(new Queue);
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Destructor. Stops all workers.
+  */
+  /*****************************************/
+  JobSystem::~JobSystem()
+  {
+    SetWorkerCount(0);
+    #ifndef BT_NO_THREADS
+    for (auto it : queues)
+      delete it;
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Sets the number of worker threads.
+
+  \param count
+  Number of workers. With 0, jobs are run by threads waiting on them.
+  */
+  /*****************************************/
+  void JobSystem::SetWorkerCount(unsigned count)
+  {
+    #ifndef BT_NO_THREADS
+    {
+      std::lock_guard<std::mutex> lock(sleeplock);
+      stopping = true;
+    }
+    sleepcv.notify_all();
+    for (auto &it : workers)
+      it.join();
+    workers.clear();
+    stopping = false;
+
+    // Leftover jobs move to the shared queue
+    for (unsigned i = 1; i < queues.size(); ++i)
+    {
+      for (auto &it : queues[i]->jobs)
+        queues[0]->jobs.push_back(it);
+      delete queues[i];
+    }
+    queues.resize(1);
+
+    for (unsigned i = 1; i <= count; ++i)
+      queues.push_back(new Queue);
+    for (unsigned i = 1; i <= count; ++i)
+      workers.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets the number of worker threads.
+  */
+  /*****************************************/
+  unsigned JobSystem::GetWorkerCount() const
+  {
+    #ifndef BT_NO_THREADS
+    return workers.size();
+    #else
+    return 0;
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Pushes a job.
+  Workers push to the back of their own queue, other threads to the
+  shared queue.
+
+  \param job
+  Job to push.
+  */
+  /*****************************************/
+  void JobSystem::Push(Job job)
+  {
+    #ifndef BT_NO_THREADS
+    Queue *queue = queues[workerowner == this ? workerindex : 0];
+    {
+      std::lock_guard<std::mutex> lock(queue->lock);
+      queue->jobs.push_back(job);
+    }
+    ++queued;
+    if (!workers.empty())
+    {
+      std::lock_guard<std::mutex> lock(sleeplock);
+      sleepcv.notify_one();
+    }
+    #else
+    Execute(job);
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Pushes a job that isn't part of any group.
+
+  \param func
+  Function to run.
+  */
+  /*****************************************/
+  void JobSystem::Push(std::function<void()> func)
+  {
+    Job job = { func, nullptr, false };
+    Push(job);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Runs a single pending job on the calling thread if there is one.
+
+  \return
+  true if a job was run.
+  */
+  /*****************************************/
+  bool JobSystem::TryRunOne()
+  {
+    #ifndef BT_NO_THREADS
+    Job job;
+    if (!Take(job)) return false;
+    Execute(job);
+    return true;
+    #else
+    return false;
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Calls func over [begin, end) split into chunks of at most grain.
+
+  \param begin
+  First index.
+
+  \param end
+  One past the last index.
+
+  \param grain
+  Max number of indices per chunk.
+
+  \param func
+  Function taking a chunk's first and one-past-last indices.
+  */
+  /*****************************************/
+  void JobSystem::ParallelFor(
+    unsigned begin, unsigned end, unsigned grain,
+    std::function<void(unsigned, unsigned)> func
+  )
+  {
+    if (!grain) grain = 1;
+    if (end - begin <= grain || !GetWorkerCount())
+    {
+      if (begin < end) func(begin, end);
+      return;
+    }
+    TaskGroup group(this);
+    // The calling thread takes the first chunk itself
+    for (unsigned b = begin + grain; b < end; b += grain)
+    {
+      unsigned e = (end - b > grain) ? b + grain : end;
+      group.Run([&func, b, e]() { func(b, e); });
+    }
+    func(begin, begin + grain);
+    group.Wait();
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Runs a job and notifies its group.
+
+  \param job
+  Job to run.
+  */
+  /*****************************************/
+  void JobSystem::Execute(Job &job)
+  {
+    job.func();
+    if (!job.group) return;
+    // The continuation finishing means the whole group is done
+    if (job.continuation) job.group->done = true;
+    else job.group->Release();
+  }
+
+  #ifndef BT_NO_THREADS
+  /*****************************************/
+  /*!
+  \brief
+  Takes a job from the calling thread's own queue or steals one.
+  A worker's own jobs are taken newest first, stolen jobs oldest first.
+
+  \param job
+  Filled with the job taken.
+
+  \return
+  true if a job was taken.
+  */
+  /*****************************************/
+  bool JobSystem::Take(Job &job)
+  {
+    if (!queued) return false;
+    unsigned self = (workerowner == this) ? workerindex : 0;
+    unsigned count = queues.size();
+    for (unsigned i = 0; i < count; ++i)
+    {
+      Queue *queue = queues[(self + i) % count];
+      std::lock_guard<std::mutex> lock(queue->lock);
+      if (queue->jobs.empty()) continue;
+      if (i == 0 && self)
+      {
+        job = queue->jobs.back();
+        queue->jobs.pop_back();
+      }
+      else
+      {
+        job = queue->jobs.front();
+        queue->jobs.pop_front();
+      }
+      --queued;
+      return true;
+    }
+    return false;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Loop run by each worker thread.
+
+  \param index
+  Index of the worker's queue.
+  */
+  /*****************************************/
+  void JobSystem::WorkerLoop(unsigned index)
+  {
+    workerindex = index;
+    workerowner = this;
+    Job job;
+    for (;;)
+    {
+      if (Take(job))
+      {
+        Execute(job);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleeplock);
+      if (stopping) break;
+      if (!queued) sleepcv.wait(lock);
+    }
+    workerowner = nullptr;
+  }
+  #endif
+}
@@ -0,0 +1,372 @@
+/******************************************************************************/
+/*!
+\file memtrack.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Heap allocation accounting per system.
+*/
+/******************************************************************************/
+#include "brewtools/memtrack.h"   // MemTrack class
+#include "brewtools/distillery.h" // Engine class
+#include "brewtools/trace.h"      // Trace class
+#include "brewtools/macros.h"     // BT_NO_THREADS
+#include <sstream>                // std::stringstream
+
+#ifdef BT_TRACK_ALLOCATIONS
+#include <cstdlib> // malloc, free, abort
+#include <cstddef> // std::max_align_t
+#include <new>     // std::nothrow_t
+#ifndef BT_NO_THREADS
+#include <atomic> // std::atomic
+#endif
+#endif
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  #ifdef BT_TRACK_ALLOCATIONS
+  #ifndef BT_NO_THREADS
+  typedef std::atomic<uint64_t> AllocCounter; //!< Counter shared by threads
+  #else
+  typedef uint64_t AllocCounter; //!< Counter shared by threads
+  #endif
+
+  /*****************************************/
+  /*!
+  \brief
+  Running counters of one tag.
+  */
+  /*****************************************/
+  struct AllocCounters
+  {
+    AllocCounter live; //!< Bytes allocated and not yet freed
+    AllocCounter highwater; //!< Most live bytes seen
+    AllocCounter bytes; //!< Bytes allocated this frame
+    AllocCounter allocs; //!< Allocations this frame
+    AllocCounter frees; //!< Frees this frame
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Written in front of every tracked allocation.
+  */
+  /*****************************************/
+  struct AllocHeader
+  {
+    size_t size; //!< Bytes requested
+    SysID tag; //!< Tag the allocation is counted against
+  };
+
+  //! Bytes in front of each allocation, keeping the result aligned
+  static const size_t ALLOC_HEADER_SIZE =
+    (sizeof(AllocHeader) + alignof(std::max_align_t) - 1) /
+    alignof(std::max_align_t) * alignof(std::max_align_t);
+
+  static AllocCounters alloccounters[BT_MAX_SYSTEMS]; //!< Counters by tag
+  static AllocStats alloclast[BT_MAX_SYSTEMS]; //!< Last frame's statistics
+  static thread_local SysID alloctag = 0; //!< Tag of the calling thread
+
+  /*****************************************/
+  /*!
+  \brief
+  Allocates memory with a header and counts it.
+
+  \param size
+  Bytes to allocate.
+
+  \return
+  Pointer to the memory, nullptr if out of memory.
+  */
+  /*****************************************/
+  static void *TrackedAlloc(size_t size)
+  {
+    char *block = (char *)malloc(size + ALLOC_HEADER_SIZE);
+    if (!block) return nullptr;
+    AllocHeader *header = (AllocHeader *)block;
+    header->size = size;
+    header->tag = alloctag;
+    AllocCounters &counters = alloccounters[header->tag];
+    uint64_t live = counters.live += size;
+    counters.bytes += size;
+    ++counters.allocs;
+    #ifndef BT_NO_THREADS
+    uint64_t high = counters.highwater;
+    while (live > high &&
+           !counters.highwater.compare_exchange_weak(high, live))
+      ;
+    #else
+    if (live > counters.highwater) counters.highwater = live;
+    #endif
+    return block + ALLOC_HEADER_SIZE;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Frees memory from TrackedAlloc and counts it against its tag.
+
+  \param ptr
+  Pointer returned by TrackedAlloc, may be nullptr.
+  */
+  /*****************************************/
+  static void TrackedFree(void *ptr)
+  {
+    if (!ptr) return;
+    char *block = (char *)ptr - ALLOC_HEADER_SIZE;
+    AllocHeader *header = (AllocHeader *)block;
+    AllocCounters &counters = alloccounters[header->tag];
+    counters.live -= header->size;
+    ++counters.frees;
+    free(block);
+  }
+  #endif
+
+  /*****************************************/
+  /*!
+  \brief
+  Sets the calling thread's tag.
+
+  \param tag
+  SysID to count allocations against, 0 for none.
+
+  \return
+  The previous tag.
+  */
+  /*****************************************/
+  SysID MemTrack::SetTag(SysID tag)
+  {
+    #ifdef BT_TRACK_ALLOCATIONS
+    SysID previous = alloctag;
+    alloctag = (tag < BT_MAX_SYSTEMS) ? tag : 0;
+    return previous;
+    #else
+    (void)tag;
+    return 0;
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets the calling thread's tag.
+  */
+  /*****************************************/
+  SysID MemTrack::GetTag()
+  {
+    #ifdef BT_TRACK_ALLOCATIONS
+    return alloctag;
+    #else
+    return 0;
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets a tag's statistics.
+
+  \param tag
+  SysID to get, 0 for untagged allocations.
+  */
+  /*****************************************/
+  AllocStats MemTrack::GetStats(SysID tag)
+  {
+    AllocStats stats = { 0, 0, 0, 0, 0 };
+    #ifdef BT_TRACK_ALLOCATIONS
+    if (tag >= BT_MAX_SYSTEMS) return stats;
+    stats = alloclast[tag];
+    stats.live = alloccounters[tag].live;
+    stats.highwater = alloccounters[tag].highwater;
+    #else
+    (void)tag;
+    #endif
+    return stats;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets the heap allocations made during the last frame by every tag.
+  */
+  /*****************************************/
+  uint64_t MemTrack::GetFrameAllocations()
+  {
+    uint64_t allocs = 0;
+    #ifdef BT_TRACK_ALLOCATIONS
+    for (SysID i = 0; i < BT_MAX_SYSTEMS; ++i)
+      allocs += alloclast[i].allocs;
+    #endif
+    return allocs;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Ends the frame, moving the per-frame counters into the last frame's
+  statistics.
+  */
+  /*****************************************/
+  void MemTrack::EndFrame()
+  {
+    #ifdef BT_TRACK_ALLOCATIONS
+    for (SysID i = 0; i < BT_MAX_SYSTEMS; ++i)
+    {
+      AllocCounters &counters = alloccounters[i];
+      #ifndef BT_NO_THREADS
+      alloclast[i].bytes = counters.bytes.exchange(0);
+      alloclast[i].allocs = counters.allocs.exchange(0);
+      alloclast[i].frees = counters.frees.exchange(0);
+      #else
+      alloclast[i].bytes = counters.bytes;
+      alloclast[i].allocs = counters.allocs;
+      alloclast[i].frees = counters.frees;
+      counters.bytes = counters.allocs = counters.frees = 0;
+      #endif
+    }
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Writes every tag with allocations to a Trace.
+
+  \param trace
+  Trace to write to.
+
+  \param level
+  Trace level to write at.
+  */
+  /*****************************************/
+  void MemTrack::Dump(Trace &trace, unsigned level)
+  {
+    #ifdef BT_TRACK_ALLOCATIONS
+    Profiler &profiler = Engine::Get()->GetProfile();
+    std::stringstream line;
+    trace[level] <<
+      "Allocations (live/high bytes, last frame bytes/allocs/frees)";
+    for (SysID i = 0; i < BT_MAX_SYSTEMS; ++i)
+    {
+      AllocStats stats = GetStats(i);
+      if (!stats.highwater) continue;
+      line.str("");
+      if (!i) line << "  Untagged";
+      else if (profiler.GetName(i)) line << "  " << profiler.GetName(i);
+      else line << "  System " << i;
+      line << ": " << stats.live << "/" << stats.highwater << ", "
+        << stats.bytes << "/" << stats.allocs << "/" << stats.frees;
+      trace[level] << line.str();
+    }
+    #else
+    (void)trace;
+    (void)level;
+    #endif
+  }
+}
+
+#ifdef BT_TRACK_ALLOCATIONS
+/*****************************************/
+/*!
+\brief
+Tracked replacement for the global operator new. Built without
+exceptions, so running out of memory aborts.
+*/
+/*****************************************/
+void *operator new(size_t size)
+{
+  void *ptr = BrewTools::TrackedAlloc(size ? size : 1);
+  if (!ptr) abort();
+  return ptr;
+}
+
+/*****************************************/
+/*!
+\brief
+Tracked replacement for the global operator new[].
+*/
+/*****************************************/
+void *operator new[](size_t size)
+{
+  void *ptr = BrewTools::TrackedAlloc(size ? size : 1);
+  if (!ptr) abort();
+  return ptr;
+}
+
+/*****************************************/
+/*!
+\brief
+Tracked replacement for the nothrow operator new.
+*/
+/*****************************************/
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  return BrewTools::TrackedAlloc(size ? size : 1);
+}
+
+/*****************************************/
+/*!
+\brief
+Tracked replacement for the nothrow operator new[].
+*/
+/*****************************************/
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+  return BrewTools::TrackedAlloc(size ? size : 1);
+}
+
+/*****************************************/
+/*!
+\brief
+Tracked replacement for the global operator delete.
+*/
+/*****************************************/
+void operator delete(void *ptr) noexcept
+{
+  BrewTools::TrackedFree(ptr);
+}
+
+/*****************************************/
+/*!
+\brief
+Tracked replacement for the global operator delete[].
+*/
+/*****************************************/
+void operator delete[](void *ptr) noexcept
+{
+  BrewTools::TrackedFree(ptr);
+}
+
+/*****************************************/
+/*!
+\brief
+Tracked replacement for the nothrow operator delete.
+*/
+/*****************************************/
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+  BrewTools::TrackedFree(ptr);
+}
+
+/*****************************************/
+/*!
+\brief
+Tracked replacement for the nothrow operator delete[].
+*/
+/*****************************************/
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+  BrewTools::TrackedFree(ptr);
+}
+#endif
@@ -0,0 +1,344 @@
+/******************************************************************************/
+/*!
+\file modules.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Systems loaded from shared objects and reloaded when they change.
+*/
+/******************************************************************************/
+#include "brewtools/modules.h"    // Modules class
+#include "brewtools/distillery.h" // Engine class
+#include "brewtools/trace.h"      // Trace class
+#include "brewtools/time.h"       // Time class
+#include <sstream>                // std::stringstream
+
+#ifdef __linux__
+#include <dlfcn.h>    // dlopen, dlsym, dlclose, dlerror
+#include <sys/stat.h> // stat
+#include <unistd.h>   // unlink
+#include <fstream>    // std::ifstream, std::ofstream
+#endif
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  /*****************************************/
+  /*!
+  \brief
+  Conversion constructor.
+
+  \param engine
+  Engine whose registry the modules' systems go in.
+  */
+  /*****************************************/
+  Modules::Modules(Engine *engine)
+    : engine(engine), count(0), reloads(0), lastpoll(0)
+  {
+    for (unsigned i = 0; i < BT_MAX_MODULES; ++i)
+    {
+      modules[i].handle = nullptr;
+      modules[i].id = 0;
+      modules[i].generation = 0;
+      modules[i].stamp = modules[i].seen = 0;
+    }
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Destructor. Closes every module.
+  */
+  /*****************************************/
+  Modules::~Modules()
+  {
+    #ifdef __linux__
+    for (unsigned i = 0; i < count; ++i)
+      if (modules[i].handle) dlclose(modules[i].handle);
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Loads a module and adds its system to the Engine.
+
+  \param path
+  Path of the shared object.
+
+  \return
+  SysID of the module's system, 0 on failure.
+  */
+  /*****************************************/
+  SysID Modules::Load(const char *path)
+  {
+    #ifdef __linux__
+    if (count == BT_MAX_MODULES)
+    {
+      Error("Too many modules! Raise BT_MAX_MODULES");
+      return 0;
+    }
+    Module &module = modules[count];
+    module.path = path;
+    module.stamp = module.seen = Stamp(module.path);
+    ProtoSystem *(*create)() = nullptr;
+    void *handle = Open(module, &create);
+    if (!handle) return 0;
+
+    // Reloads keep this SysID, so the module only ever uses up one
+    SysID id = ProtoSystem::NextSysID();
+    uint64_t start = Time::Precise();
+    ProtoSystem *system;
+    {
+      Engine::Scope scope(engine);
+      AllocTag tag(id);
+      system = create();
+    }
+    if (!engine->AddSystem(id, system, nullptr, start))
+    {
+      delete system;
+      dlclose(handle);
+      return 0;
+    }
+    module.handle = handle;
+    module.id = id;
+    ++count;
+    engine->GetProfile().SetName(id, module.name.c_str());
+    return id;
+    #else
+    (void)path;
+    Error("Modules are only supported on Linux");
+    return 0;
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Reloads a module now, whether its file changed or not.
+
+  \param id
+  SysID returned by Load.
+
+  \return
+  true if the new module replaced the old one.
+  */
+  /*****************************************/
+  bool Modules::Reload(SysID id)
+  {
+    #ifdef __linux__
+    Module *module = nullptr;
+    for (unsigned i = 0; i < count; ++i)
+      if (modules[i].id == id) module = &modules[i];
+    if (!module) return false;
+    module->stamp = module->seen = Stamp(module->path);
+
+    // Everything that can fail happens before the old module is touched
+    ProtoSystem *(*create)() = nullptr;
+    void *handle = Open(*module, &create);
+    if (!handle) return false;
+
+    ProtoSystem *old = engine->systems[id];
+    std::vector<char> state;
+    old->Serialize(state);
+    Engine::Scope scope(engine);
+    ProtoSystem *system;
+    {
+      AllocTag tag(id);
+      system = create();
+      system->Deserialize(state);
+    }
+    // No system is updating between frames, so the swap is never seen
+    // half done
+    engine->systems[id] = system;
+    engine->phasesdirty = true;
+    {
+      AllocTag tag(id);
+      delete old;
+    }
+    dlclose(module->handle);
+    module->handle = handle;
+    engine->GetProfile().SetName(id, module->name.c_str());
+    ++reloads;
+
+    Trace *trace = engine->GetSystemIfExists<Trace>();
+    if (trace)
+    {
+      std::stringstream line;
+      line << "Reloaded module " << module->name << " (" << state.size() <<
+        " bytes of state)";
+      BT_TRACE_TO(trace, 1, line.str());
+    }
+    return true;
+    #else
+    (void)id;
+    return false;
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets the SysID of a loaded module.
+
+  \param name
+  Name given to BT_MODULE.
+
+  \return
+  SysID of the module's system, 0 if there is no such module.
+  */
+  /*****************************************/
+  SysID Modules::Find(const char *name) const
+  {
+    for (unsigned i = 0; i < count; ++i)
+      if (modules[i].name == name) return modules[i].id;
+    return 0;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets a module's system.
+
+  \param id
+  SysID returned by Load.
+
+  \return
+  Pointer to the system, nullptr if id isn't a module.
+  */
+  /*****************************************/
+  ProtoSystem *Modules::Get(SysID id) const
+  {
+    for (unsigned i = 0; i < count; ++i)
+      if (modules[i].id == id) return engine->systems[id];
+    return nullptr;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Reloads every module whose file changed and has stopped changing.
+  A file is only reloaded once two checks in a row see the same stamp,
+  so a module isn't opened while the linker is still writing it.
+  */
+  /*****************************************/
+  void Modules::Poll()
+  {
+    if (!count) return;
+    uint64_t now = Time::Precise();
+    if (now - lastpoll < BT_MODULE_POLL) return;
+    lastpoll = now;
+    for (unsigned i = 0; i < count; ++i)
+    {
+      Module &module = modules[i];
+      uint64_t stamp = Stamp(module.path);
+      if (stamp && stamp != module.stamp && stamp == module.seen)
+        Reload(module.id);
+      else
+        module.seen = stamp;
+    }
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Opens a private copy of a module's file. dlopen returns the already
+  open handle for a path it has seen, so each load gets a new file name.
+  The copy is deleted once open.
+
+  \param module
+  Module to open. Its name is set from the module.
+
+  \param create
+  Filled with the module's factory.
+
+  \return
+  Handle of the copy, nullptr on failure.
+  */
+  /*****************************************/
+  void *Modules::Open(Module &module, ProtoSystem *(**create)())
+  {
+    #ifdef __linux__
+    std::stringstream copy;
+    copy << module.path << ".bt" << module.generation++;
+    {
+      std::ifstream in(module.path.c_str(), std::ios::binary);
+      std::ofstream out(copy.str().c_str(), std::ios::binary);
+      if (!in || !out)
+      {
+        Error("Couldn't copy module " + module.path);
+        return nullptr;
+      }
+      out << in.rdbuf();
+    }
+    void *handle = dlopen(copy.str().c_str(), RTLD_NOW | RTLD_LOCAL);
+    unlink(copy.str().c_str());
+    if (!handle)
+    {
+      Error(dlerror());
+      return nullptr;
+    }
+    *create = (ProtoSystem *(*)())dlsym(handle, "BrewToolsCreateModule");
+    const char *(*name)() =
+      (const char *(*)())dlsym(handle, "BrewToolsModuleName");
+    if (!*create || !name)
+    {
+      Error("No BT_MODULE in " + module.path);
+      dlclose(handle);
+      return nullptr;
+    }
+    // Copied, the old name goes away with its module
+    module.name = name();
+    return handle;
+    #else
+    (void)module;
+    (void)create;
+    return nullptr;
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets a file's modification time and size mixed into one value.
+
+  \return
+  The stamp, 0 if the file can't be read.
+  */
+  /*****************************************/
+  uint64_t Modules::Stamp(const std::string &path)
+  {
+    #ifdef __linux__
+    struct stat info;
+    if (stat(path.c_str(), &info)) return 0;
+    uint64_t stamp = uint64_t(info.st_mtim.tv_sec) * 1000000000 +
+      info.st_mtim.tv_nsec;
+    return stamp ^ (uint64_t(info.st_size) << 32);
+    #else
+    (void)path;
+    return 0;
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Writes a module error through Trace.
+  */
+  /*****************************************/
+  void Modules::Error(const std::string &message)
+  {
+    Trace *trace = engine->GetSystemIfExists<Trace>();
+    BT_TRACE_TO(trace, 0, message);
+  }
+}
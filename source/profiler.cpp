@@ -0,0 +1,197 @@
+/******************************************************************************/
+/*!
+\file profiler.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Per-system frame profiler filled in by Engine::Update.
+*/
+/******************************************************************************/
+#include "brewtools/profiler.h" // Profiler class
+#include "brewtools/trace.h"    // Trace class
+#include <algorithm>            // std::sort
+#include <sstream>              // std::stringstream
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  /*****************************************/
+  /*!
+  \brief
+  Default constructor. Profiling starts enabled.
+  */
+  /*****************************************/
+  Profiler::Profiler() : enabled(true)
+  {
+    for (SysID i = 0; i < BT_MAX_SYSTEMS; ++i)
+    {
+      systems[i].count = systems[i].next = 0;
+      current[i] = 0;
+      names[i] = nullptr;
+    }
+    frames.count = frames.next = 0;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Ends the frame, pushing a sample for the frame and every system that
+  was scheduled this frame.
+
+  \param us
+  Microseconds the whole frame took.
+
+  \param scheduled
+  Bit per SysID of the systems scheduled this frame.
+  */
+  /*****************************************/
+  void Profiler::EndFrame(uint64_t us, uint64_t scheduled)
+  {
+    Push(frames, us);
+    for (SysID i = 1; i < BT_MAX_SYSTEMS; ++i)
+    {
+      if (scheduled & (uint64_t(1) << i)) Push(systems[i], current[i]);
+      current[i] = 0;
+    }
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets the rolling statistics of a system.
+
+  \param id
+  ID of the system.
+  */
+  /*****************************************/
+  ProfileStats Profiler::GetStats(SysID id) const
+  {
+    if (id >= BT_MAX_SYSTEMS) return Compute(systems[0]);
+    return Compute(systems[id]);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets the rolling statistics of whole frames.
+  */
+  /*****************************************/
+  ProfileStats Profiler::GetFrameStats() const
+  {
+    return Compute(frames);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Names a system for dumps.
+
+  \param id
+  ID of the system.
+
+  \param name
+  Name of the system. Must outlive the profiler.
+  */
+  /*****************************************/
+  void Profiler::SetName(SysID id, const char *name)
+  {
+    if (id < BT_MAX_SYSTEMS) names[id] = name;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets the name of a system, nullptr if it doesn't have one.
+  */
+  /*****************************************/
+  const char *Profiler::GetName(SysID id) const
+  {
+    return (id < BT_MAX_SYSTEMS) ? names[id] : nullptr;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Writes the frame and every profiled system's statistics to a Trace.
+
+  \param trace
+  Trace to write to.
+
+  \param level
+  Trace level to write at.
+  */
+  /*****************************************/
+  void Profiler::Dump(Trace &trace, unsigned level) const
+  {
+    // Lines are built first, Trace only writes its first operand to file
+    ProfileStats stats = Compute(frames);
+    std::stringstream line;
+    line << "Profile over " << stats.samples
+      << " frames (us min/avg/p95/p99/max)";
+    trace[level] << line.str();
+    for (SysID i = 0; i < BT_MAX_SYSTEMS; ++i)
+    {
+      if (i)
+      {
+        if (!systems[i].count) continue;
+        stats = Compute(systems[i]);
+      }
+      line.str("");
+      if (!i) line << "  Frame";
+      else if (names[i]) line << "  " << names[i];
+      else line << "  System " << i;
+      line << ": " << stats.min << "/" << stats.avg << "/" << stats.p95
+        << "/" << stats.p99 << "/" << stats.max;
+      trace[level] << line.str();
+    }
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Adds a sample to a ring, overwriting the oldest once full.
+  */
+  /*****************************************/
+  void Profiler::Push(Ring &ring, uint64_t us)
+  {
+    ring.samples[ring.next] = (us > 0xFFFFFFFF) ? 0xFFFFFFFF : uint32_t(us);
+    ring.next = (ring.next + 1) % BT_PROFILE_SAMPLES;
+    if (ring.count < BT_PROFILE_SAMPLES) ++ring.count;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Works out the statistics of a ring.
+  */
+  /*****************************************/
+  ProfileStats Profiler::Compute(const Ring &ring)
+  {
+    ProfileStats stats = { 0, 0, 0, 0, 0, ring.count };
+    if (!ring.count) return stats;
+    uint32_t sorted[BT_PROFILE_SAMPLES];
+    uint64_t total = 0;
+    for (unsigned i = 0; i < ring.count; ++i)
+    {
+      sorted[i] = ring.samples[i];
+      total += sorted[i];
+    }
+    std::sort(sorted, sorted + ring.count);
+    stats.min = sorted[0];
+    stats.max = sorted[ring.count - 1];
+    stats.avg = total / ring.count;
+    stats.p95 = sorted[(ring.count - 1) * 95 / 100];
+    stats.p99 = sorted[(ring.count - 1) * 99 / 100];
+    return stats;
+  }
+}
@@ -0,0 +1,418 @@
+/******************************************************************************/
+/*!
+\file recorder.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Records a session's external inputs frame by frame and replays them.
+*/
+/******************************************************************************/
+#include "brewtools/recorder.h"   // Recorder class
+#include "brewtools/distillery.h" // Engine class
+#include "brewtools/trace.h"      // Trace class
+#include "brewtools/time.h"       // Time class
+#include <cstring>                // memcmp
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  const uint8_t Recorder::PHASE_BEFORE;
+
+  //! First bytes of a recording, the last one is the format version
+  static const char RECORDING_MAGIC[8] = { 'B', 'T', 'R', 'E', 'C', 0, 0, 2 };
+
+  //! Fewest bytes an input takes in a recording: type, phase and size
+  static const unsigned RECORDED_INPUT_SIZE = 13;
+
+  /*****************************************/
+  /*!
+  \brief
+  Writes a value to a recording.
+  */
+  /*****************************************/
+  template <typename T>
+  static void WriteValue(std::ofstream &file, T value)
+  {
+    file.write((const char *)&value, sizeof(T));
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Reads a value from a recording.
+
+  \return
+  false if the file ended.
+  */
+  /*****************************************/
+  template <typename T>
+  static bool ReadValue(std::ifstream &file, T &value)
+  {
+    return bool(file.read((char *)&value, sizeof(T)));
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets the bytes left in a recording being read.
+  */
+  /*****************************************/
+  static uint64_t Remaining(std::ifstream &file, std::streamoff size)
+  {
+    std::streamoff at = file.tellg();
+    return (at >= 0 && at < size) ? uint64_t(size - at) : 0;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Conversion constructor.
+
+  \param events
+  Event bus inputs are delivered on.
+  */
+  /*****************************************/
+  Recorder::Recorder(EventBus *events)
+    : events(events), recording(false), replaying(false), finished(false),
+      inframe(false), phase(PHASE_BEFORE), frame(0)
+  {
+    for (unsigned i = 0; i < BT_MAX_EVENT_TYPES; ++i)
+    {
+      emitters[i] = nullptr;
+      sizes[i] = 0;
+      hashes[i] = 0;
+    }
+    current.current = current.elapsed = 0;
+    // Built-in inputs are sent from callbacks that don't fire in headless
+    // replays, so they're registered up front
+    Register<WindowResizeEvent>();
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Destructor. Stops recording or replaying.
+  */
+  /*****************************************/
+  Recorder::~Recorder()
+  {
+    Stop();
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Starts recording, from the next Engine::Update on.
+
+  \param path
+  File to record to.
+
+  \return
+  true if the file could be opened.
+  */
+  /*****************************************/
+  bool Recorder::Record(const std::string &path)
+  {
+    Stop();
+    file.open(path.c_str(), std::ios::binary);
+    if (!file.is_open()) return false;
+    file.write(RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+    current.inputs.clear();
+    carried.clear();
+    frame = 0;
+    recording = true;
+    return true;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Starts replaying a recording, from the next Engine::Update on.
+  The whole recording is read up front, so replaying doesn't touch the
+  disk. Counts and sizes are checked against the rest of the file before
+  anything is allocated for them, so a broken recording fails instead of
+  aborting.
+
+  \param path
+  File to replay.
+
+  \return
+  true if the recording could be read.
+  */
+  /*****************************************/
+  bool Recorder::Replay(const std::string &path)
+  {
+    Stop();
+    std::ifstream in(path.c_str(), std::ios::binary);
+    in.seekg(0, std::ios::end);
+    std::streamoff length = in.tellg();
+    in.seekg(0);
+    char magic[sizeof(RECORDING_MAGIC)];
+    if (!in.read(magic, sizeof(magic)) ||
+        memcmp(magic, RECORDING_MAGIC, sizeof(magic)))
+      return false;
+
+    frames.clear();
+    Frame next;
+    uint32_t count;
+    while (ReadValue(in, next.current) && ReadValue(in, next.elapsed) &&
+           ReadValue(in, count))
+    {
+      // Each input takes at least its type, phase and size
+      if (count > Remaining(in, length) / RECORDED_INPUT_SIZE)
+      {
+        frames.clear();
+        return false;
+      }
+      next.inputs.resize(count);
+      for (auto &it : next.inputs)
+      {
+        uint32_t size;
+        if (!ReadValue(in, it.type) || !ReadValue(in, it.phase) ||
+            !ReadValue(in, size) || size > Remaining(in, length))
+        {
+          frames.clear();
+          return false;
+        }
+        // An input the size of another type is from a different build
+        EventTypeID type = FindType(it.type);
+        if (type < BT_MAX_EVENT_TYPES && sizes[type] != size)
+        {
+          Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
+          BT_TRACE_TO(trace, 0, "Recording " << path <<
+            " doesn't match this build's input types!");
+          frames.clear();
+          return false;
+        }
+        it.data.resize(size);
+        if (size && !in.read(it.data.data(), size))
+        {
+          frames.clear();
+          return false;
+        }
+      }
+      frames.push_back(next);
+    }
+    frame = 0;
+    finished = false;
+    replaying = true;
+    return true;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Stops recording or replaying.
+  */
+  /*****************************************/
+  void Recorder::Stop()
+  {
+    if (recording) file.close();
+    recording = replaying = false;
+    frames.clear();
+    Time::Freeze(0);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Starts a frame.
+
+  \return
+  false if a replay has run out of frames.
+  */
+  /*****************************************/
+  bool Recorder::BeginFrame()
+  {
+    {
+      #ifndef BT_NO_THREADS
+      std::lock_guard<std::mutex> guard(lock);
+      #endif
+      inframe = true;
+      phase = 0;
+    }
+    if (recording)
+    {
+      Time::Freeze(0);
+      current.current = Time::Current();
+      current.elapsed = 0;
+      Time::Freeze(current.current);
+    }
+    else if (replaying)
+    {
+      if (frame >= frames.size())
+      {
+        Stop();
+        finished = true;
+        inframe = false;
+        phase = PHASE_BEFORE;
+        return false;
+      }
+      Time::Freeze(frames[frame].current);
+      EmitPhase(PHASE_BEFORE);
+    }
+    return true;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Records or replays the time the fixed step accumulates this frame.
+
+  \param elapsed
+  Time since the last fixed step update in us.
+
+  \return
+  The time to accumulate in us.
+  */
+  /*****************************************/
+  uint64_t Recorder::Elapsed(uint64_t elapsed)
+  {
+    if (recording) current.elapsed = elapsed;
+    else if (replaying) return frames[frame].elapsed;
+    return elapsed;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Ends a phase.
+
+  \param ended
+  Phase that ended.
+  */
+  /*****************************************/
+  void Recorder::EndPhase(unsigned ended)
+  {
+    if (replaying) EmitPhase(uint8_t(ended));
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
+    phase = uint8_t(ended + 1);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Ends a frame, writing it out while recording.
+  */
+  /*****************************************/
+  void Recorder::EndFrame()
+  {
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
+    inframe = false;
+    phase = PHASE_BEFORE;
+    if (!recording && !replaying) return;
+    ++frame;
+    if (!recording) return;
+    WriteValue(file, current.current);
+    WriteValue(file, current.elapsed);
+    WriteValue(file, uint32_t(current.inputs.size()));
+    for (auto &it : current.inputs)
+    {
+      WriteValue(file, it.type);
+      WriteValue(file, it.phase);
+      WriteValue(file, uint32_t(it.data.size()));
+      file.write(it.data.data(), it.data.size());
+    }
+    current.inputs.clear();
+    current.inputs.swap(carried);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Adds an input to the frame being recorded.
+  */
+  /*****************************************/
+  void Recorder::Store(EventTypeID type, const void *data, unsigned size)
+  {
+    // Too many event types to register it, so it couldn't be replayed
+    if (type >= BT_MAX_EVENT_TYPES) return;
+    Recorded input;
+    input.type = hashes[type];
+    input.data.assign((const char *)data, (const char *)data + size);
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
+    input.phase = inframe ? phase : PHASE_BEFORE;
+    if (input.phase == ProtoSystem::PHASE_COUNT)
+    {
+      // The last phase's Dispatch has run, so the next frame's first one
+      // delivers it. Replaying it before that frame does the same
+      input.phase = PHASE_BEFORE;
+      carried.push_back(input);
+      return;
+    }
+    current.inputs.push_back(input);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Emits the replayed frame's inputs from one phase.
+  */
+  /*****************************************/
+  void Recorder::EmitPhase(uint8_t from)
+  {
+    for (auto &it : frames[frame].inputs)
+    {
+      if (it.phase != from) continue;
+      EventTypeID type = FindType(it.type);
+      if (type >= BT_MAX_EVENT_TYPES || sizes[type] != it.data.size())
+      {
+        Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
+        BT_TRACE_TO(trace, 0, "Replayed an input type that isn't registered!");
+        continue;
+      }
+      emitters[type](*events, it.data.data());
+    }
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Hashes a name with 64 bit FNV-1a.
+  */
+  /*****************************************/
+  uint64_t Recorder::HashName(const char *name)
+  {
+    uint64_t hash = 14695981039346656037ull;
+    for (; *name; ++name)
+    {
+      hash ^= uint8_t(*name);
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Finds the registered input type with a hash.
+
+  \return
+  The type's ID, BT_MAX_EVENT_TYPES if none is registered.
+  */
+  /*****************************************/
+  EventTypeID Recorder::FindType(uint64_t hash) const
+  {
+    for (EventTypeID i = 0; i < BT_MAX_EVENT_TYPES; ++i)
+    {
+      if (emitters[i] && hashes[i] == hash) return i;
+    }
+    return BT_MAX_EVENT_TYPES;
+  }
+}
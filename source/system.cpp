@@ -13,6 +13,11 @@ Base class for systems.
 */
 /******************************************************************************/
 #include "brewtools/system.h"
+#include "brewtools/macros.h" // BT_NO_THREADS
+
+#ifndef BT_NO_THREADS
+#include <atomic> // std::atomic
+#endif
 
 /*****************************************/
 /*!
@@ -22,8 +27,32 @@ Brewtools namespace.
 /*****************************************/
 namespace BrewTools
 {
+  #ifndef BT_NO_THREADS
+  static std::atomic<SysID> systemidcount(0); //!< Total number of SysIDs.
+  #else
   static SysID systemidcount; //!< Total number of SysIDs.
+  #endif
+  #ifndef BT_NO_THREADS
+  //! Bumped whenever a system changes phases. Systems may init in parallel
+  static std::atomic<unsigned> phaseversion(0);
+  #else
+  static unsigned phaseversion; //!< Bumped whenever a system changes phases
+  #endif
   
+    /*****************************************/
+    /*!
+    \brief
+    Default constructor.
+    */
+    /*****************************************/
+    ProtoSystem::ProtoSystem()
+      : readmask(0), writemask(0), declared(false), mainthread(false),
+        phasemask(1u << PHASE_UPDATE), policy(UPDATE_ALWAYS), policyvalue(1)
+    {
+      for (unsigned i = 0; i < PHASE_COUNT; ++i)
+        priorities[i] = 0;
+    }
+
     /*****************************************/
     /*!
     \brief
@@ -46,8 +75,145 @@ namespace BrewTools
     Gets the number of SysIDs
     */
     /*****************************************/
-    SysID& ProtoSystem::GetSysIDCount()
+    SysID ProtoSystem::GetSysIDCount()
     {
       return systemidcount;
     }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gives out the next SysID.
+    */
+    /*****************************************/
+    SysID ProtoSystem::NextSysID()
+    {
+      return ++systemidcount;
+    }
+    
+    /*****************************************/
+    /*!
+    \brief
+    Marks this system's accesses as declared.
+    */
+    /*****************************************/
+    void ProtoSystem::DeclareAccess()
+    {
+      declared = true;
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Declares that this system reads another system during Update.
+
+    \param id
+    ID of the system that is read.
+    */
+    /*****************************************/
+    void ProtoSystem::DeclareRead(SysID id)
+    {
+      declared = true;
+      if (id < BT_MAX_SYSTEMS) readmask |= uint64_t(1) << id;
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Declares that this system modifies another system during Update.
+
+    \param id
+    ID of the system that is written.
+    */
+    /*****************************************/
+    void ProtoSystem::DeclareWrite(SysID id)
+    {
+      declared = true;
+      if (id < BT_MAX_SYSTEMS) writemask |= uint64_t(1) << id;
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Moves the system to a single phase.
+
+    \param phase
+    Phase to update in.
+
+    \param priority
+    Order within the phase. Lower priorities update first.
+    */
+    /*****************************************/
+    void ProtoSystem::SetPhase(Phase phase, int priority)
+    {
+      phasemask = 0;
+      AddPhase(phase, priority);
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Adds a phase the system also updates in.
+
+    \param phase
+    Phase to update in.
+
+    \param priority
+    Order within the phase. Lower priorities update first.
+    */
+    /*****************************************/
+    void ProtoSystem::AddPhase(Phase phase, int priority)
+    {
+      if (phase >= PHASE_COUNT) return;
+      phasemask |= 1u << phase;
+      priorities[phase] = priority;
+      ++phaseversion;
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Stops the system from updating in a phase.
+
+    \param phase
+    Phase to leave.
+    */
+    /*****************************************/
+    void ProtoSystem::RemovePhase(Phase phase)
+    {
+      if (phase >= PHASE_COUNT) return;
+      phasemask &= ~(1u << phase);
+      ++phaseversion;
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Sets how often the system updates.
+
+    \param newpolicy
+    How often to update.
+
+    \param value
+    N for UPDATE_EVERY_N and UPDATE_FREQUENCY, ignored otherwise.
+    */
+    /*****************************************/
+    void ProtoSystem::SetUpdatePolicy(UpdatePolicy newpolicy, unsigned value)
+    {
+      policy = newpolicy;
+      policyvalue = value ? value : 1;
+      ++phaseversion;
+    }
+
+    /*****************************************/
+    /*!
+    \brief
+    Gets a counter bumped whenever any system changes its phases or
+    update policy.
+    */
+    /*****************************************/
+    unsigned ProtoSystem::GetPhaseVersion()
+    {
+      return phaseversion;
+    }
 }
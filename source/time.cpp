@@ -15,8 +15,13 @@ Time management system.
 #include "brewtools/time.h"
 #include "brewtools/trace.h"
 #include "brewtools/distillery.h"
+#include "brewtools/macros.h" // BT_NO_THREADS
 #include <ctime>
 
+#ifndef BT_NO_THREADS
+#include <atomic> // std::atomic
+#endif
+
 #ifdef _3DS //The following only exists in a 3DS build
 #include <3ds.h>
 #elif _WIN32 //The following only exists in a Windows build
@@ -30,6 +35,13 @@ Brewtools namespace.
 /*****************************************/
 namespace BrewTools
 {
+  #ifndef BT_NO_THREADS
+  //! Time returned by Current, 0 for the clock. Read by any thread
+  static std::atomic<uint64_t> frozentime(0);
+  #else
+  static uint64_t frozentime; //!< Time returned by Current, 0 for the clock
+  #endif
+
   /*****************************************/
   /*!
   \brief
@@ -38,9 +50,13 @@ namespace BrewTools
   /*****************************************/
   Time::Time()
   {
+    DeclareAccess();
+    SetPhase(PHASE_INPUT);
+    // Update does nothing, so the Engine never needs to dispatch it
+    SetUpdatePolicy(UPDATE_ON_WAKE);
+    Engine::Get()->GetProfile().SetName(id, "Time");
     Trace *trace = Engine::Get()->GetSystemIfExists<Trace>();
-    if (trace)
-      (*trace)[5] << "Creating Time system...";
+    BT_TRACE_TO(trace, 5, "Creating Time system...");
     start_time = Current();
     if (trace)
     {
@@ -50,7 +66,7 @@ namespace BrewTools
         "Time system created at %s",
         std::ctime((std::time_t *)(&start_time))
       );
-      (*trace)[5] << buffer;
+      BT_TRACE_TO(trace, 5, buffer);
     }
   }
   
@@ -65,12 +81,13 @@ namespace BrewTools
   /*****************************************/
   void Time::Sleep(uint64_t time)
   {
-    uint64_t start = Current();
+    // Precise is never frozen
+    uint64_t start = Precise();
     uint64_t current = start;
-    uint64_t end = start + time;
+    uint64_t end = start + time * 1000;
     while (current < end)
     {
-      current = Current();
+      current = Precise();
     }
   }
   
@@ -85,14 +102,51 @@ namespace BrewTools
   /*****************************************/
   uint64_t Time::Current()
   {
+    uint64_t frozen = frozentime;
+    if (frozen) return frozen;
     #ifdef _3DS //The following only exists in a 3DS build
     return osGetTime();
-    #elif _WIN32 //The following only exists in a Windows build
+    #else
     return std::chrono::duration_cast< std::chrono::milliseconds >
     (std::chrono::system_clock::now().time_since_epoch()).count();
     #endif
   }
   
+  /*****************************************/
+  /*!
+  \brief
+  Makes Current return a fixed time.
+
+  \param time
+  Time in ms for Current to return, 0 to go back to the clock.
+  */
+  /*****************************************/
+  void Time::Freeze(uint64_t time)
+  {
+    frozentime = time;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets the current time from a monotonic high resolution clock.
+  
+  \return
+  Current time in microseconds
+  */
+  /*****************************************/
+  uint64_t Time::Precise()
+  {
+    #ifdef _3DS //The following only exists in a 3DS build
+    uint64_t ticks = svcGetSystemTick();
+    return (ticks / SYSCLOCK_ARM11) * 1000000 +
+      (ticks % SYSCLOCK_ARM11) * 1000000 / SYSCLOCK_ARM11;
+    #else
+    return std::chrono::duration_cast< std::chrono::microseconds >
+    (std::chrono::steady_clock::now().time_since_epoch()).count();
+    #endif
+  }
+  
   /*****************************************/
   /*!
   \brief
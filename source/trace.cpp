@@ -14,8 +14,11 @@ Empty shell of a file to be filled out. Not meant to be compiled anywhere.
 /******************************************************************************/
 #include "brewtools/trace.h"   // Trace class
 #include "brewtools/console.h" // Console class
+#include "brewtools/distillery.h" // Engine class
+#include "brewtools/time.h"    // Time class
 #include <iostream>            // std::cout
-#include <algorithm>           // std::remove
+#include <cstdio>              // snprintf
+#include <cstring>             // memcpy
 
 #ifdef _3DS //The following only exists in a 3DS build
 #include <3ds/console.h>      //!< 3DS's console
@@ -38,38 +41,43 @@ Brewtools namespace.
 /*****************************************/
 namespace BrewTools
 {
+  //! Level of the next line this thread traces, set by operator[]
+  static thread_local unsigned tracelevel = 0;
+
   /*****************************************/
   /*!
   \brief
-  Prints the stream to the currently selected console
+  What a BT_TRACE_BIN format ID stands for.
   */
   /*****************************************/
-  void Trace::PrintStream()
+  struct BinaryFormat
   {
-    std::string str = stream.str();
-    str.erase(
-      std::remove(str.begin(), str.end(), '\n'),
-      str.end()
-      );
-    str.erase(
-      std::remove(str.begin(), str.end(), '\r'),
-      str.end()
-      );
-    if (str.empty()) return;
-    std::cout << std::endl << str;
-    stream.str("");
-  }
-  
+    unsigned level; //!< Level of the call site
+    const char *format; //!< Format string, a literal
+    const char *signature; //!< Argument types, see TraceBinary
+  };
+
+  //! Formats of the BT_TRACE_BIN call sites by ID - 1
+  static std::vector<BinaryFormat> formats;
+  #ifndef BT_NO_THREADS
+  static std::mutex formatlock; //!< Guards formats
+  #endif
+
   /*****************************************/
   /*!
   \brief
   Default Constructor.
   */
   /*****************************************/
-  Trace::Trace() : m_path(), m_os(), m_level(0), m_console(nullptr),
-  m_printing(false), max_print_level(-1)
+  Trace::Trace() : m_path(), m_os(), m_console(nullptr), m_printing(false),
+  max_print_level(-1), historynext(0), historycount(0)
+  #ifndef BT_NO_THREADS
+  , ring(nullptr), tail(0), written(0), running(false)
+  #endif
   {
-    stream.str("");
+    DeclareAccess();
+    SetPhase(PHASE_PRESENT, 100); // Flush after everything else
+    Engine::Get()->GetProfile().SetName(id, "Trace");
   }
   
   /*****************************************/
@@ -81,10 +89,15 @@ namespace BrewTools
   Path of file to trace to.
   */
   /*****************************************/
-  Trace::Trace(std::string path) : m_path(), m_os(), m_level(0),
-  m_console(nullptr), m_printing(false)
+  Trace::Trace(std::string path) : m_path(), m_os(), m_console(nullptr),
+  m_printing(false), max_print_level(-1), historynext(0), historycount(0)
+  #ifndef BT_NO_THREADS
+  , ring(nullptr), tail(0), written(0), running(false)
+  #endif
   {
-    stream.str("");
+    DeclareAccess();
+    SetPhase(PHASE_PRESENT, 100); // Flush after everything else
+    Engine::Get()->GetProfile().SetName(id, "Trace");
     OpenFile(path);
   }
   
@@ -96,6 +109,8 @@ namespace BrewTools
   /*****************************************/
   Trace::~Trace()
   {
+    SetAsync(false);
+    CloseBinary();
     CloseFile();
   }
   
@@ -115,6 +130,9 @@ namespace BrewTools
   /*****************************************/
   bool Trace::OpenFile(std::string path)
   {
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
     CloseFile();
     std::ofstream new_os(path);
     if (new_os.is_open())
@@ -141,6 +159,9 @@ namespace BrewTools
   /*****************************************/
   bool Trace::IsFileOpen() const
   {
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
     return m_os.is_open();
   }
   
@@ -150,27 +171,128 @@ namespace BrewTools
   Outputs a string to the console and file (if one is open).
   
   \return
-  Reference to the original Trace.
+  The line being traced.
   */
   /*****************************************/
-  std::stringstream &Trace::operator<<(const std::string output)
+  TraceStream Trace::operator<<(const std::string &output)
   {
-    if (m_level > max_print_level)
+    unsigned level = tracelevel;
+    TraceStream line(IsEnabled(level) ? this : nullptr, level);
+    line << output;
+    return line;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Outputs a line to the console and file (if one is open), or to the
+  async ring or binary log.
+
+  \param level
+  Level of the line.
+
+  \param text
+  The line.
+
+  \param length
+  Characters in the line.
+  */
+  /*****************************************/
+  void Trace::Write(unsigned level, const char *text, size_t length)
+  {
+    #ifndef BT_NO_THREADS
+    if (ring)
     {
-      garbage.str("");
-      return garbage;
+      if (level <= max_print_level) Push(level, text, length);
+      return;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
+    if (level > max_print_level) return;
+
+    if (binaryfile.is_open())
+    {
+      TraceBinary::Put(binary, uint8_t(TraceBinary::RECORD_TEXT));
+      TraceBinary::Put(binary, uint32_t(level));
+      TraceBinary::Put(binary, Time::Precise());
+      TraceBinary::PutString(binary, text, length);
+      EndRecord();
+      Remember(level, text, length);
+      return;
     }
 
+    char prefix[16];
+    int size = snprintf(prefix, sizeof(prefix), "[%u] ", level);
     if (m_console && m_printing)
     {
-      stream << "[" << m_level << "] " << output;
-      PrintStream();
+      std::cout << std::endl;
+      std::cout.write(prefix, size);
+      const char *end = text + length;
+      for (const char *start = text; start < end; )
+      {
+        const char *stop = start;
+        while (stop < end && *stop != '\n' && *stop != '\r') ++stop;
+        std::cout.write(start, stop - start);
+        start = stop + 1;
+      }
     }
-    
-    if (IsFileOpen())
-      m_os << std::endl << "[" << m_level << "] " << output;
-    
-    return stream;
+
+    if (m_os.is_open())
+    {
+      m_os << std::endl;
+      m_os.write(prefix, size);
+      m_os.write(text, length);
+    }
+
+    Remember(level, text, length);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Adds a line to the history.
+
+  \param level
+  Level of the line.
+
+  \param text
+  The line.
+
+  \param length
+  Characters in the line.
+  */
+  /*****************************************/
+  void Trace::Remember(unsigned level, const char *text, size_t length)
+  {
+    char prefix[16];
+    int size = snprintf(prefix, sizeof(prefix), "[%u] ", level);
+    // Assigning keeps the capacity, so lines stop allocating once grown
+    std::string &line = history[historynext];
+    line.assign(prefix, size).append(text, length);
+    historynext = (historynext + 1) % BT_TRACE_HISTORY;
+    if (historycount < BT_TRACE_HISTORY) ++historycount;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets the last BT_TRACE_HISTORY lines that were printed. In async mode,
+  lines the writer hasn't reached yet are left out; call Flush first.
+
+  \param lines
+  Filled with the lines, oldest first.
+  */
+  /*****************************************/
+  void Trace::GetRecent(std::vector<std::string> &lines) const
+  {
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
+    lines.clear();
+    unsigned first = (historynext + BT_TRACE_HISTORY - historycount) %
+      BT_TRACE_HISTORY;
+    for (unsigned i = 0; i < historycount; ++i)
+      lines.push_back(history[(first + i) % BT_TRACE_HISTORY]);
   }
   
   /*****************************************/
@@ -186,7 +308,7 @@ namespace BrewTools
   /*****************************************/
   Trace &Trace::operator[](const unsigned level)
   {
-    m_level = level;
+    tracelevel = level;
     return *this;
   }
   
@@ -198,7 +320,7 @@ namespace BrewTools
   /*****************************************/
   void Trace::CloseFile()
   {
-    if (IsFileOpen())
+    if (m_os.is_open())
     {
       m_os.close();
       m_path.clear();
@@ -213,7 +335,10 @@ namespace BrewTools
   /*****************************************/
   void Trace::Update()
   {
-    PrintStream();
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
+    WriteBinary();
   }
   
   
@@ -225,7 +350,9 @@ namespace BrewTools
   /*****************************************/
   void Trace::SelectConsole(Console *console)
   {
-    PrintStream();
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
     if (m_console) m_console->m_selected = false;
     m_console = console;
     if (m_console) m_console->m_selected = true;
@@ -239,4 +366,367 @@ namespace BrewTools
     if (!m_printing && m_console) m_printing = true;
     else if (!m_console) m_printing = false;
   }
+
+  /*****************************************/
+  /*!
+  \brief
+  Turns async mode on or off.
+
+  \param enable
+  true to write from the writer thread.
+
+  \return
+  true if the mode was set, false if threads are disabled or Trace is in
+  binary mode.
+  */
+  /*****************************************/
+  bool Trace::SetAsync(bool enable)
+  {
+    #ifndef BT_NO_THREADS
+    if (enable == (ring != nullptr)) return true;
+    if (enable)
+    {
+      if (IsBinary()) return false;
+      ring = new Record[BT_TRACE_RING];
+      for (uint64_t i = 0; i < BT_TRACE_RING; ++i)
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+      tail = 0;
+      written = 0;
+      running = true;
+      writer = std::thread(&Trace::WriterLoop, this);
+    }
+    else
+    {
+      // The writer drains the ring before it stops
+      running = false;
+      writer.join();
+      delete[] ring;
+      ring = nullptr;
+    }
+    return true;
+    #else
+    return !enable;
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Determines if Trace is in async mode.
+  */
+  /*****************************************/
+  bool Trace::IsAsync() const
+  {
+    #ifndef BT_NO_THREADS
+    return ring != nullptr;
+    #else
+    return false;
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Waits until every line traced so far has been written.
+  */
+  /*****************************************/
+  void Trace::Flush()
+  {
+    #ifndef BT_NO_THREADS
+    if (!ring) return;
+    uint64_t target = tail;
+    while (written < target)
+      std::this_thread::yield();
+    #endif
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Starts binary mode, writing everything traced to a binary log.
+
+  \param path
+  Path of the binary log.
+
+  \return
+  true if the log could be opened.
+  */
+  /*****************************************/
+  bool Trace::OpenBinary(const std::string &path)
+  {
+    SetAsync(false);
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
+    if (binaryfile.is_open())
+    {
+      WriteBinary();
+      binaryfile.close();
+    }
+    binaryfile.open(path.c_str(), std::ios::binary);
+    if (!binaryfile.is_open()) return false;
+    defined.clear();
+    binary.clear();
+    // Room for the record that goes over, so it doesn't grow the buffer
+    binary.reserve(2 * BT_TRACE_BINARY_BUFFER);
+    binary.insert(binary.end(), TraceBinary::MAGIC,
+      TraceBinary::MAGIC + sizeof(TraceBinary::MAGIC));
+    TraceBinary::Put(binary, TraceBinary::ORDER_MARK);
+    TraceBinary::Put(binary, Time::Current());
+    TraceBinary::Put(binary, Time::Precise());
+    WriteBinary();
+    return true;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Writes out the rest of the binary log and leaves binary mode.
+  */
+  /*****************************************/
+  void Trace::CloseBinary()
+  {
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
+    if (!binaryfile.is_open()) return;
+    WriteBinary();
+    binaryfile.close();
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Determines if Trace is in binary mode.
+  */
+  /*****************************************/
+  bool Trace::IsBinary() const
+  {
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(lock);
+    #endif
+    return binaryfile.is_open();
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Formats a format string up to its next "{}".
+
+  \return
+  The format string after the "{}", nullptr if there was none.
+  */
+  /*****************************************/
+  const char *Trace::FormatNext(TraceLine &out, const char *format)
+  {
+    const char *start = format;
+    for (; *format; ++format)
+    {
+      if (format[0] == '{' && format[1] == '}')
+      {
+        out.Append(start, format - start);
+        return format + 2;
+      }
+    }
+    out.Append(start, format - start);
+    return nullptr;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gives a BT_TRACE_BIN call site its format ID.
+
+  \param site
+  Format ID of the call site, set unless another thread set it first.
+
+  \return
+  The format ID.
+  */
+  /*****************************************/
+  unsigned Trace::RegisterFormat(TraceSite &site, unsigned level,
+    const char *format, const char *signature)
+  {
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> guard(formatlock);
+    #endif
+    unsigned id = site;
+    if (id) return id;
+    BinaryFormat added = { level, format, signature };
+    formats.push_back(added);
+    id = unsigned(formats.size());
+    site = id;
+    return id;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Starts a message record in the binary log, defining its format first
+  if the log hasn't seen it yet.
+
+  \return
+  false if Trace isn't in binary mode.
+  */
+  /*****************************************/
+  bool Trace::BeginMessage(unsigned id)
+  {
+    if (!binaryfile.is_open()) return false;
+    if (id >= defined.size()) defined.resize(id + 1, false);
+    if (!defined[id])
+    {
+      BinaryFormat format;
+      {
+        #ifndef BT_NO_THREADS
+        std::lock_guard<std::mutex> guard(formatlock);
+        #endif
+        format = formats[id - 1];
+      }
+      TraceBinary::Put(binary, uint8_t(TraceBinary::RECORD_FORMAT));
+      TraceBinary::Put(binary, uint32_t(id));
+      TraceBinary::Put(binary, uint32_t(format.level));
+      TraceBinary::PutString(binary, format.signature,
+        strlen(format.signature));
+      TraceBinary::PutString(binary, format.format, strlen(format.format));
+      defined[id] = true;
+    }
+    TraceBinary::Put(binary, uint8_t(TraceBinary::RECORD_MESSAGE));
+    TraceBinary::Put(binary, uint32_t(id));
+    TraceBinary::Put(binary, Time::Precise());
+    return true;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Ends a record, writing the buffer out once it's big enough.
+  */
+  /*****************************************/
+  void Trace::EndRecord()
+  {
+    if (binary.size() >= BT_TRACE_BINARY_BUFFER) WriteBinary();
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Writes the buffered records to the binary log.
+  */
+  /*****************************************/
+  void Trace::WriteBinary()
+  {
+    if (binary.empty() || !binaryfile.is_open()) return;
+    binaryfile.write(binary.data(), binary.size());
+    binaryfile.flush();
+    binary.clear();
+  }
+
+  #ifndef BT_NO_THREADS
+  /*****************************************/
+  /*!
+  \brief
+  Copies a line into the async ring. The line's records are reserved
+  together, so they come out in one piece even with many callers.
+
+  \param level
+  Level of the line.
+
+  \param text
+  The line.
+
+  \param size
+  Characters in the line.
+  */
+  /*****************************************/
+  void Trace::Push(unsigned level, const char *text, size_t size)
+  {
+    uint64_t count = (size + BT_TRACE_RECORD - 1) / BT_TRACE_RECORD;
+    if (!count) count = 1;
+    if (count > BT_TRACE_RING) count = BT_TRACE_RING;
+    uint64_t position = tail.fetch_add(count);
+    for (uint64_t i = 0; i < count; ++i)
+    {
+      Record &record = ring[(position + i) & (BT_TRACE_RING - 1)];
+      // Only waits when the ring is full
+      while (record.sequence.load(std::memory_order_acquire) != position + i)
+        std::this_thread::yield();
+      unsigned length = (size < BT_TRACE_RECORD) ? size : BT_TRACE_RECORD;
+      record.level = level;
+      record.length = length;
+      record.more = (i + 1 < count);
+      memcpy(record.text, text, length);
+      text += length;
+      size -= length;
+      record.sequence.store(position + i + 1, std::memory_order_release);
+    }
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Writes lines from the async ring until async mode is turned off.
+  Every line ready is gathered into one batch, written with a single
+  write and flush to each output.
+  */
+  /*****************************************/
+  void Trace::WriterLoop()
+  {
+    uint64_t head = 0;
+    std::string line, file, console;
+    for (;;)
+    {
+      // Read before draining, so nothing pushed before stopping is lost
+      bool stopping = !running;
+      uint64_t start = head;
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        while (head - start < BT_TRACE_RING)
+        {
+          Record &record = ring[head & (BT_TRACE_RING - 1)];
+          if (record.sequence.load(std::memory_order_acquire) != head + 1)
+            break;
+          line.append(record.text, record.length);
+          unsigned level = record.level;
+          bool more = record.more;
+          record.sequence.store(
+            head + BT_TRACE_RING, std::memory_order_release
+          );
+          ++head;
+          if (more) continue;
+
+          char prefix[16];
+          snprintf(prefix, sizeof(prefix), "\n[%u] ", level);
+          if (m_os.is_open())
+            file.append(prefix).append(line);
+          if (m_console && m_printing)
+          {
+            console.append(prefix);
+            for (auto it : line)
+              if (it != '\n' && it != '\r') console.push_back(it);
+          }
+          Remember(level, line.data(), line.size());
+          line.clear();
+        }
+        if (!file.empty())
+        {
+          m_os.write(file.data(), file.size());
+          m_os.flush();
+          file.clear();
+        }
+        if (!console.empty())
+        {
+          std::cout.write(console.data(), console.size());
+          std::cout.flush();
+          console.clear();
+        }
+      }
+      if (head != start)
+        written = head;
+      else if (stopping)
+        return;
+      else
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  #endif
 }
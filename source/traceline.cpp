@@ -0,0 +1,144 @@
+/******************************************************************************/
+/*!
+\file traceline.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Fixed size buffer trace lines are formatted into.
+*/
+/******************************************************************************/
+#include "brewtools/traceline.h" // TraceLine class
+#include <cstdint>               // uintptr_t
+#include <cstdio>                // snprintf
+#include <cstring>               // memcpy
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  //! Digits of every base integers are added in
+  static const char DIGITS[] = "0123456789abcdef";
+
+  /*****************************************/
+  /*!
+  \brief
+  Adds characters to the line, as many as fit.
+
+  \param characters
+  Characters to add.
+
+  \param count
+  Number of characters.
+
+  \return
+  Reference to the line.
+  */
+  /*****************************************/
+  TraceLine &TraceLine::Append(const char *characters, size_t count)
+  {
+    size_t room = MAX_TRACE_LENGTH - 1 - length;
+    if (count > room) count = room;
+    memcpy(text + length, characters, count);
+    length += count;
+    text[length] = 0;
+    return *this;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Adds an address in hex.
+  */
+  /*****************************************/
+  TraceLine &TraceLine::operator<<(const void *value)
+  {
+    if (!value) return Append("0", 1);
+    unsigned saved = base;
+    base = 16;
+    Append("0x", 2);
+    Unsigned(uintptr_t(value));
+    base = saved;
+    return *this;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Applies std::endl, std::ends or std::flush.
+  */
+  /*****************************************/
+  TraceLine &TraceLine::operator<<(
+    std::ostream &(*manipulator)(std::ostream &))
+  {
+    typedef std::ostream &(*Manipulator)(std::ostream &);
+    if (manipulator == static_cast<Manipulator>(std::endl))
+      return Append("\n", 1);
+    return *this;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Applies std::dec, std::hex or std::oct to the integers after it.
+  */
+  /*****************************************/
+  TraceLine &TraceLine::operator<<(
+    std::ios_base &(*manipulator)(std::ios_base &))
+  {
+    if (manipulator == std::dec) base = 10;
+    else if (manipulator == std::hex) base = 16;
+    else if (manipulator == std::oct) base = 8;
+    return *this;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Adds an unsigned integer in the current base. Digits are written from
+  the back of a scratch buffer, then copied in one go.
+
+  \param value
+  The integer.
+
+  \param negative
+  true to add a minus sign first.
+  */
+  /*****************************************/
+  TraceLine &TraceLine::Unsigned(unsigned long long value, bool negative)
+  {
+    // 64 bits in octal is 22 digits, plus the sign
+    char digits[24];
+    char *start = digits + sizeof(digits);
+    do
+    {
+      *--start = DIGITS[value % base];
+      value /= base;
+    } while (value);
+    if (negative) *--start = '-';
+    return Append(start, digits + sizeof(digits) - start);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Adds a float like "%g", which is how streams format them by default.
+  */
+  /*****************************************/
+  TraceLine &TraceLine::Float(double value)
+  {
+    // "%g" never needs more than "-1.23457e+308"
+    char digits[32];
+    int count = snprintf(digits, sizeof(digits), "%g", value);
+    if (count <= 0) return *this;
+    return Append(digits, size_t(count));
+  }
+}
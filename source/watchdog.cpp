@@ -0,0 +1,218 @@
+/******************************************************************************/
+/*!
+\file watchdog.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Frame budget watchdog writing hitch reports.
+*/
+/******************************************************************************/
+#include "brewtools/watchdog.h"   // Watchdog class
+#include "brewtools/distillery.h" // Engine class
+#include "brewtools/trace.h"      // Trace class
+#include "brewtools/time.h"       // Time class
+#include <fstream>                // std::ofstream
+#include <sstream>                // std::stringstream
+#include <vector>                 // std::vector
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  /*****************************************/
+  /*!
+  \brief
+  Clamps a count to 32 bits.
+  */
+  /*****************************************/
+  static uint32_t Clamp32(uint64_t value)
+  {
+    return (value > 0xFFFFFFFF) ? 0xFFFFFFFF : uint32_t(value);
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Conversion constructor. The watchdog starts disabled.
+
+  \param engine
+  Engine being watched.
+  */
+  /*****************************************/
+  Watchdog::Watchdog(Engine *engine)
+    : engine(engine), next(0), count(0), budget(0), number(0), lastend(0),
+      quiet(0), hitches(0), skipped(0), path("hitch-"), lastreport()
+  {}
+
+  /*****************************************/
+  /*!
+  \brief
+  Sets the frame budget. Clears the history.
+
+  \param us
+  Longest a frame may take in microseconds. 0 disables the watchdog.
+  */
+  /*****************************************/
+  void Watchdog::SetBudget(uint64_t us)
+  {
+    budget = us;
+    next = count = 0;
+    lastend = 0;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Records the frame and writes a report if it went over budget.
+
+  \param update
+  Microseconds Engine::Update took.
+  */
+  /*****************************************/
+  void Watchdog::EndFrame(uint64_t update)
+  {
+    if (!budget) return;
+    uint64_t now = Time::Precise();
+    // The first frame has nothing to be measured from
+    if (!lastend)
+    {
+      lastend = now;
+      return;
+    }
+    Frame &frame = frames[next];
+    frame.number = ++number;
+    frame.total = Clamp32(now - lastend);
+    frame.update = Clamp32(update);
+    const Profiler &profiler = engine->GetProfile();
+    for (SysID i = 0; i < BT_MAX_SYSTEMS; ++i)
+    {
+      frame.times[i] = Clamp32(profiler.GetCurrent(i));
+      frame.allocs[i] = Clamp32(MemTrack::GetStats(i).allocs);
+    }
+    next = (next + 1) % BT_WATCHDOG_FRAMES;
+    if (count < BT_WATCHDOG_FRAMES) ++count;
+    lastend = now;
+
+    if (frame.total <= budget) return;
+    ++hitches;
+    if (frame.number < quiet)
+    {
+      ++skipped;
+      return;
+    }
+    Report(frame);
+    quiet = frame.number + BT_WATCHDOG_FRAMES;
+    skipped = 0;
+    // Writing the report shouldn't count against the next frame
+    lastend = Time::Precise();
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Writes the history to a new report file, with a column for each system
+  that did anything in it.
+
+  \param hitch
+  The frame that went over budget.
+  */
+  /*****************************************/
+  void Watchdog::Report(const Frame &hitch)
+  {
+    std::stringstream name;
+    name << path << hitch.number << ".txt";
+    std::ofstream file(name.str().c_str());
+    Trace *trace = engine->GetSystemIfExists<Trace>();
+    if (!file.is_open())
+    {
+      BT_TRACE_TO(trace, 0, "Couldn't write hitch report " + name.str());
+      return;
+    }
+
+    const Profiler &profiler = engine->GetProfile();
+    unsigned first = (next + BT_WATCHDOG_FRAMES - count) % BT_WATCHDOG_FRAMES;
+    uint64_t timed = 0, allocating = 0;
+    for (unsigned n = 0; n < count; ++n)
+    {
+      const Frame &frame = frames[(first + n) % BT_WATCHDOG_FRAMES];
+      for (SysID i = 0; i < BT_MAX_SYSTEMS; ++i)
+      {
+        if (frame.times[i]) timed |= uint64_t(1) << i;
+        if (frame.allocs[i]) allocating |= uint64_t(1) << i;
+      }
+    }
+
+    file << "Hitch at frame " << hitch.number << ": " << hitch.total <<
+      "us (budget " << budget << "us)";
+    if (skipped)
+      file << ", " << skipped << " earlier hitches not reported";
+    file << std::endl << std::endl << "Frame times in us, oldest first" <<
+      std::endl << "frame\ttotal\tupdate";
+    for (SysID i = 1; i < BT_MAX_SYSTEMS; ++i)
+    {
+      if (!(timed & (uint64_t(1) << i))) continue;
+      if (profiler.GetName(i)) file << "\t" << profiler.GetName(i);
+      else file << "\tSystem " << i;
+    }
+    file << std::endl;
+    for (unsigned n = 0; n < count; ++n)
+    {
+      const Frame &frame = frames[(first + n) % BT_WATCHDOG_FRAMES];
+      file << frame.number << "\t" << frame.total << "\t" << frame.update;
+      for (SysID i = 1; i < BT_MAX_SYSTEMS; ++i)
+        if (timed & (uint64_t(1) << i)) file << "\t" << frame.times[i];
+      file << std::endl;
+    }
+
+    if (allocating)
+    {
+      file << std::endl << "Allocations, oldest first" << std::endl <<
+        "frame";
+      for (SysID i = 0; i < BT_MAX_SYSTEMS; ++i)
+      {
+        if (!(allocating & (uint64_t(1) << i))) continue;
+        if (!i) file << "\tUntagged";
+        else if (profiler.GetName(i)) file << "\t" << profiler.GetName(i);
+        else file << "\tSystem " << i;
+      }
+      file << std::endl;
+      for (unsigned n = 0; n < count; ++n)
+      {
+        const Frame &frame = frames[(first + n) % BT_WATCHDOG_FRAMES];
+        file << frame.number;
+        for (SysID i = 0; i < BT_MAX_SYSTEMS; ++i)
+          if (allocating & (uint64_t(1) << i)) file << "\t" << frame.allocs[i];
+        file << std::endl;
+      }
+    }
+
+    if (trace)
+    {
+      std::vector<std::string> lines;
+      trace->Flush();
+      trace->GetRecent(lines);
+      file << std::endl << "Recent trace" << std::endl;
+      for (auto &it : lines)
+        file << it << std::endl;
+    }
+    file.close();
+    lastreport = name.str();
+
+    if (trace)
+    {
+      std::stringstream line;
+      line << "Frame " << hitch.number << " took " << hitch.total <<
+        "us (budget " << budget << "us), wrote " << lastreport;
+      BT_TRACE_TO(trace, 1, line.str());
+    }
+  }
+}
@@ -0,0 +1,316 @@
+/******************************************************************************/
+/*!
+\file zones.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Scoped profiling zones exported as Chrome trace-event JSON.
+*/
+/******************************************************************************/
+#include "brewtools/zones.h"  // Zones class
+#include "brewtools/macros.h" // BT_NO_THREADS
+#include "brewtools/time.h"   // Time::Precise
+#include <cstdint>            // uint64_t
+#include <fstream>            // std::ofstream
+#include <vector>             // std::vector
+
+#ifndef BT_NO_THREADS
+#include <atomic> // std::atomic
+#include <mutex>  // std::mutex
+#endif
+
+/*****************************************/
+/*!
+\brief
+Brewtools namespace.
+*/
+/*****************************************/
+namespace BrewTools
+{
+  #ifndef BT_NO_THREADS
+  typedef std::atomic<unsigned> ZoneCounter; //!< Counter shared by threads
+  #else
+  typedef unsigned ZoneCounter; //!< Counter shared by threads
+  #endif
+
+  /*****************************************/
+  /*!
+  \brief
+  A recorded begin or end of a zone.
+  */
+  /*****************************************/
+  struct ZoneEvent
+  {
+    const char *name; //!< Name of the zone
+    uint64_t time; //!< Microseconds from Time::Precise
+    bool begin; //!< Determines if this begins or ends the zone
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Ring of events written by one thread and read by Flush.
+  */
+  /*****************************************/
+  struct ZoneBuffer
+  {
+    ZoneEvent events[BT_ZONE_EVENTS]; //!< The ring
+    ZoneCounter head; //!< Events written, only changed by the owner
+    ZoneCounter tail; //!< Events flushed, only changed by Flush
+    unsigned open; //!< Zones begun and not ended, only used by the owner
+    unsigned tid; //!< Thread number written to the file
+    bool exited; //!< Set once the owner exits, guarded by zonelock
+  };
+
+  /*****************************************/
+  /*!
+  \brief
+  Frees the calling thread's buffer when the thread exits.
+  */
+  /*****************************************/
+  struct ZoneOwner
+  {
+    ~ZoneOwner();
+    ZoneBuffer *buffer; //!< The thread's buffer
+  };
+
+  static std::vector<ZoneBuffer *> zonebuffers; //!< Buffers of every thread
+  static std::vector<unsigned> zonetids; //!< Thread numbers free for reuse
+  static thread_local ZoneBuffer *zonelocal = nullptr; //!< This thread's
+  static thread_local ZoneOwner zoneowner; //!< Frees zonelocal on exit
+  static std::ofstream zonefile; //!< File being written
+  static bool zonefirst = true; //!< Determines if no event was written yet
+  static ZoneCounter zonedropped(0); //!< Events dropped from full buffers
+  //! Bumped for each file, so zones can't end in a file they didn't begin in
+  static ZoneCounter zonesession(0);
+  #ifndef BT_NO_THREADS
+  static std::mutex zonelock; //!< Guards zonebuffers
+  static std::atomic<bool> zonerecording(false); //!< Set while a file is open
+  #else
+  static bool zonerecording = false; //!< Set while a file is open
+  #endif
+
+  /*****************************************/
+  /*!
+  \brief
+  Frees a buffer and lets its thread number be reused. zonelock must be
+  held.
+  */
+  /*****************************************/
+  static void FreeZoneBuffer(ZoneBuffer *buffer)
+  {
+    for (auto it = zonebuffers.begin(); it != zonebuffers.end(); ++it)
+    {
+      if (*it == buffer)
+      {
+        zonebuffers.erase(it);
+        break;
+      }
+    }
+    zonetids.push_back(buffer->tid);
+    delete buffer;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Destructor. Frees the buffer now if it's been written out, otherwise
+  leaves it for Flush to free.
+  */
+  /*****************************************/
+  ZoneOwner::~ZoneOwner()
+  {
+    if (!buffer) return;
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> lock(zonelock);
+    #endif
+    zonelocal = nullptr;
+    if (buffer->head == buffer->tail) FreeZoneBuffer(buffer);
+    else buffer->exited = true;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Starts writing zones to a file, closing any previous one.
+
+  \param path
+  Path of the JSON file to write.
+
+  \return
+  true if the file was opened.
+  */
+  /*****************************************/
+  bool Zones::Start(std::string path)
+  {
+    Stop();
+    zonefile.open(path.c_str());
+    if (!zonefile.is_open()) return false;
+    // The JSON array format may be left unterminated if the game dies
+    zonefile << "[";
+    zonefirst = true;
+    ++zonesession;
+    zonerecording = true;
+    return true;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Flushes remaining events and closes the file.
+  */
+  /*****************************************/
+  void Zones::Stop()
+  {
+    if (!zonefile.is_open()) return;
+    // Zones still open stay unterminated, which viewers handle, instead
+    // of their ends going in the next file
+    zonerecording = false;
+    ++zonesession;
+    Flush();
+    zonefile << "\n]\n";
+    zonefile.close();
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Writes every buffered event to the file.
+  */
+  /*****************************************/
+  void Zones::Flush()
+  {
+    if (!zonefile.is_open()) return;
+    #ifndef BT_NO_THREADS
+    std::lock_guard<std::mutex> lock(zonelock);
+    #endif
+    std::vector<ZoneBuffer *> exited;
+    for (auto it : zonebuffers)
+    {
+      unsigned head = it->head;
+      for (unsigned i = it->tail; i != head; ++i)
+      {
+        const ZoneEvent &event = it->events[i & (BT_ZONE_EVENTS - 1)];
+        zonefile << (zonefirst ? "\n" : ",\n") << "{\"name\":\"";
+        for (const char *c = event.name; *c; ++c)
+        {
+          if (*c == '"' || *c == '\\') zonefile << '\\';
+          zonefile << *c;
+        }
+        zonefile << "\",\"ph\":\"" << (event.begin ? 'B' : 'E')
+          << "\",\"ts\":" << event.time << ",\"pid\":0,\"tid\":" << it->tid
+          << "}";
+        zonefirst = false;
+      }
+      it->tail = head;
+      if (it->exited) exited.push_back(it);
+    }
+    for (auto it : exited)
+      FreeZoneBuffer(it);
+    zonefile.flush();
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Gets the number of events dropped because a thread's buffer was full.
+  */
+  /*****************************************/
+  unsigned Zones::GetDropped()
+  {
+    return zonedropped;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Adds an event to the calling thread's buffer, which has room for it.
+  */
+  /*****************************************/
+  static void RecordZone(const char *name, bool begin)
+  {
+    uint64_t time = Time::Precise();
+    unsigned head = zonelocal->head;
+    ZoneEvent &event = zonelocal->events[head & (BT_ZONE_EVENTS - 1)];
+    event.name = name;
+    event.time = time;
+    event.begin = begin;
+    zonelocal->head = head + 1;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Records the start of a zone on the calling thread. Drops it if nothing
+  is being written, or the thread's buffer has no room for both ends.
+
+  \param name
+  Name of the zone. Must outlive the flush.
+
+  \return
+  File session the zone was begun in, 0 if the zone was dropped.
+  */
+  /*****************************************/
+  unsigned Zones::Begin(const char *name)
+  {
+    if (!zonerecording) return 0;
+    if (!zonelocal)
+    {
+      // First zone on this thread, the buffer is kept for the next Flush
+      ZoneBuffer *buffer = new ZoneBuffer;
+      buffer->head = 0;
+      buffer->tail = 0;
+      buffer->open = 0;
+      buffer->exited = false;
+      #ifndef BT_NO_THREADS
+      std::lock_guard<std::mutex> lock(zonelock);
+      #endif
+      if (zonetids.empty()) buffer->tid = zonebuffers.size();
+      else
+      {
+        buffer->tid = zonetids.back();
+        zonetids.pop_back();
+      }
+      zonebuffers.push_back(buffer);
+      zonelocal = buffer;
+      zoneowner.buffer = buffer;
+    }
+    // Room is kept for the end of every open zone, so ends never drop
+    unsigned used = zonelocal->head - zonelocal->tail + zonelocal->open;
+    if (used + 2 > BT_ZONE_EVENTS)
+    {
+      zonedropped += 2;
+      return 0;
+    }
+    unsigned session = zonesession;
+    RecordZone(name, true);
+    ++zonelocal->open;
+    return session;
+  }
+
+  /*****************************************/
+  /*!
+  \brief
+  Records the end of a zone on the calling thread.
+
+  \param name
+  Name of the zone. Must outlive the flush.
+
+  \param session
+  Returned by Begin. The end is dropped if its begin was, or if the
+  begin went in a file that's been closed since.
+  */
+  /*****************************************/
+  void Zones::End(const char *name, unsigned session)
+  {
+    if (!session || !zonelocal) return;
+    --zonelocal->open;
+    if (session != zonesession) return;
+    RecordZone(name, false);
+  }
+}
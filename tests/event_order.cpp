@@ -0,0 +1,84 @@
+/******************************************************************************/
+/*!
+\file event_order.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Checks that events from one thread arrive in the order they were emitted,
+even when the ring fills and they spill into the overflow list while the
+main thread is dispatching.
+*/
+/******************************************************************************/
+#include "brewtools.h"
+#include <atomic>  // std::atomic
+#include <cstdio>  // printf
+#include <thread>  // std::thread
+
+using namespace BrewTools;
+
+//! Event carrying its place in the order it was emitted
+struct Numbered
+{
+  unsigned number;
+};
+
+int main()
+{
+  int failures = 0;
+  const unsigned total = 200000;
+  const unsigned producers = 2;
+  EventBus bus;
+  unsigned next[producers] = {};
+  unsigned received = 0;
+  unsigned outoforder = 0;
+  bus.Subscribe<Numbered>(
+    [&](const Numbered *events, unsigned count) {
+      for (unsigned i = 0; i < count; ++i)
+      {
+        unsigned producer = events[i].number % producers;
+        unsigned number = events[i].number / producers;
+        if (number != next[producer]) ++outoforder;
+        next[producer] = number + 1;
+        ++received;
+      }
+    });
+
+  // Producers emit faster than Dispatch takes, so the ring keeps filling
+  std::atomic<unsigned> done(0);
+  std::thread threads[producers];
+  for (unsigned p = 0; p < producers; ++p)
+  {
+    threads[p] = std::thread([&bus, &done, p, total]() {
+      for (unsigned i = 0; i < total; ++i)
+      {
+        Numbered event = { i * producers + p };
+        bus.Emit(event);
+      }
+      ++done;
+    });
+  }
+  while (done != producers)
+    bus.Dispatch();
+  for (unsigned p = 0; p < producers; ++p)
+    threads[p].join();
+  bus.Dispatch();
+
+  if (outoforder)
+  {
+    printf("%u events arrived out of order\n", outoforder);
+    ++failures;
+  }
+  if (received != total * producers)
+  {
+    printf("%u of %u events arrived\n", received, total * producers);
+    ++failures;
+  }
+
+  if (!failures) printf("event_order passed\n");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,112 @@
+/******************************************************************************/
+/*!
+\file recorder_replay.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Records window resizes in one Engine and replays them in another that
+never saw a resize, checking each arrives in the same frame.
+*/
+/******************************************************************************/
+#include "brewtools.h"
+#include <cstdio>  // printf
+#include <vector>  // std::vector
+
+using namespace BrewTools;
+
+//! A resize as delivered: frame, width and height
+struct Delivered
+{
+  unsigned frame;
+  int width;
+  int height;
+};
+
+/*****************************************/
+/*!
+\brief
+Updates an Engine for a number of frames, collecting the resizes it
+delivers. While recording, sends a resize every third frame.
+
+\return
+The resizes delivered.
+*/
+/*****************************************/
+static std::vector<Delivered> Run(Engine *engine, bool record)
+{
+  std::vector<Delivered> delivered;
+  unsigned frame = 0;
+  unsigned handle = engine->GetEvents().Subscribe<WindowResizeEvent>(
+    [&delivered, &frame](const WindowResizeEvent *resizes, unsigned count) {
+      for (unsigned i = 0; i < count; ++i)
+      {
+        Delivered each = { frame, resizes[i].width, resizes[i].height };
+        delivered.push_back(each);
+      }
+    });
+  for (frame = 0; frame < 12; ++frame)
+  {
+    if (record && frame % 3 == 0)
+    {
+      WindowResizeEvent resize = { 640 + int(frame), 480 + int(frame) };
+      engine->GetRecorder().Input(resize);
+    }
+    if (!engine->Update()) break;
+  }
+  engine->GetEvents().Unsubscribe<WindowResizeEvent>(handle);
+  return delivered;
+}
+
+int main()
+{
+  int failures = 0;
+  Engine *recorded = Engine::Create();
+  recorded->SetHeadless(true);
+  if (!recorded->GetRecorder().Record("recorder_replay.rec"))
+  {
+    printf("Couldn't open the recording\n");
+    return 1;
+  }
+  std::vector<Delivered> live = Run(recorded, true);
+  recorded->GetRecorder().Stop();
+  recorded->Shutdown();
+
+  // A fresh Engine has never had a resize sent through it
+  Engine *replayed = Engine::Create();
+  replayed->SetHeadless(true);
+  if (!replayed->GetRecorder().Replay("recorder_replay.rec"))
+  {
+    printf("Couldn't read the recording\n");
+    return 1;
+  }
+  std::vector<Delivered> replay = Run(replayed, false);
+  replayed->GetRecorder().Stop();
+  replayed->Shutdown();
+
+  if (live.size() != 4 || replay.size() != live.size())
+  {
+    printf("%u resizes were sent, %u replayed\n", unsigned(live.size()),
+      unsigned(replay.size()));
+    ++failures;
+  }
+  for (size_t i = 0; i < live.size() && i < replay.size(); ++i)
+  {
+    if (live[i].frame != replay[i].frame ||
+        live[i].width != replay[i].width ||
+        live[i].height != replay[i].height)
+    {
+      printf("Resize %u was %dx%d in frame %u, replayed %dx%d in frame %u\n",
+        unsigned(i), live[i].width, live[i].height, live[i].frame,
+        replay[i].width, replay[i].height, replay[i].frame);
+      ++failures;
+    }
+  }
+
+  if (!failures) printf("recorder_replay passed\n");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,143 @@
+/******************************************************************************/
+/*!
+\file threaded_systems.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Stress test of getting systems and tracing from many workers at once.
+Run with "make test SANITIZE=thread" to check it's race free.
+*/
+/******************************************************************************/
+#include "brewtools.h"
+#include <atomic>  // std::atomic
+#include <cstdio>  // printf
+#include <fstream> // std::ifstream
+#include <string>  // std::string
+#include <thread>  // std::this_thread
+
+using namespace BrewTools;
+
+//! Number of each lazy system built
+static std::atomic<int> built[3];
+
+/*****************************************/
+/*!
+\brief
+System created lazily by whichever worker asks first. Slow to build, so
+workers pile up waiting for it.
+*/
+/*****************************************/
+template <int N>
+class Lazy : public System<Lazy<N> >
+{
+public:
+  Lazy()
+  {
+    ++built[N];
+    std::this_thread::sleep_for(std::chrono::microseconds(500));
+  }
+  void Update() {}
+};
+
+/*****************************************/
+/*!
+\brief
+System whose constructor asks for itself.
+*/
+/*****************************************/
+class Selfish : public System<Selfish>
+{
+public:
+  Selfish() : self(Engine::Get()->GetSystem<Selfish>()) {}
+  void Update() {}
+  Selfish *self; //!< What the constructor got for itself
+};
+
+int main()
+{
+  int failures = 0;
+  Engine *engine = Engine::Get();
+  engine->SetHeadless(true);
+  engine->InitializeAll();
+  engine->SetWorkerCount(8);
+  Trace *trace = engine->GetSystem<Trace>();
+  trace->OpenFile("threaded_systems.log");
+
+  std::atomic<int> mismatched(0);
+  {
+    TaskGroup group(&engine->GetJobs());
+    for (int i = 0; i < 256; ++i)
+    {
+      group.Run([&mismatched, i]() {
+        Engine *engine = Engine::Get();
+        ProtoSystem *a = engine->GetSystem<Lazy<0> >();
+        ProtoSystem *b = engine->GetSystem<Lazy<1> >();
+        ProtoSystem *c = engine->GetSystem<Lazy<2> >();
+        if (!a || a != engine->GetSystem<Lazy<0> >() ||
+            !b || b != engine->GetSystem<Lazy<1> >() ||
+            !c || c != engine->GetSystem<Lazy<2> >())
+          ++mismatched;
+        // Chained lines must come out whole
+        (*engine->GetSystem<Trace>())[1] << "worker " << i << " line " << i;
+      });
+    }
+    // The main thread keeps updating while the workers run
+    for (int frame = 0; frame < 20; ++frame)
+      engine->Update();
+    group.Wait();
+  }
+
+  for (int n = 0; n < 3; ++n)
+  {
+    if (built[n] != 1)
+    {
+      printf("Lazy<%d> was built %d times\n", n, built[n].load());
+      ++failures;
+    }
+  }
+  if (mismatched)
+  {
+    printf("%d workers got different systems\n", mismatched.load());
+    ++failures;
+  }
+
+  // Asking for itself fails instead of waiting forever
+  Selfish *selfish = engine->GetSystem<Selfish>();
+  if (!selfish || selfish->self)
+  {
+    printf("A constructor asking for its own system didn't get nullptr\n");
+    ++failures;
+  }
+
+  trace->OpenFile("threaded_systems_done.log");
+  std::ifstream log("threaded_systems.log");
+  std::string line;
+  int lines = 0;
+  while (std::getline(log, line))
+  {
+    if (line.find("worker ") == std::string::npos) continue;
+    int a, b;
+    char rest;
+    if (sscanf(line.c_str(), "[1] worker %d line %d%c", &a, &b, &rest) != 2 ||
+        a != b)
+    {
+      printf("Broken line: %s\n", line.c_str());
+      ++failures;
+    }
+    ++lines;
+  }
+  if (lines != 256)
+  {
+    printf("%d of 256 worker lines were traced\n", lines);
+    ++failures;
+  }
+
+  engine->Shutdown();
+  if (!failures) printf("threaded_systems passed\n");
+  return failures ? 1 : 0;
+}
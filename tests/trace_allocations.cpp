@@ -0,0 +1,127 @@
+/******************************************************************************/
+/*!
+\file trace_allocations.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Checks BT_TRACE and BT_TRACE_BIN don't touch the heap once warmed up, in
+sync, async and binary mode, and that TraceLine formats like a
+std::stringstream.
+*/
+/******************************************************************************/
+#include "brewtools.h"
+#include <cstdio>  // printf
+#include <cstdlib> // malloc, free
+#include <new>     // operator new
+#include <sstream> // std::stringstream
+#include <string>  // std::string
+
+using namespace BrewTools;
+
+//! Allocations made by this thread
+static thread_local long allocations = 0;
+
+void *operator new(size_t size)
+{
+  ++allocations;
+  return malloc(size ? size : 1);
+}
+
+void operator delete(void *memory) noexcept { free(memory); }
+void operator delete(void *memory, size_t) noexcept { free(memory); }
+
+/*****************************************/
+/*!
+\brief
+Traces a mix of argument types, and counts the allocations made after
+100 warm up iterations. The warm up goes through the same call sites, so
+binary formats are registered and buffers have grown by then.
+
+\param label
+Name of the mode, for the report.
+
+\return
+Allocations made after the warm up.
+*/
+/*****************************************/
+static long Run(const char *label)
+{
+  int count = 42;
+  double ms = 1.25;
+  std::string name = "hero";
+  short small = -7;
+  unsigned long long big = 18446744073709551615ull;
+  long long negative = -9223372036854775807ll - 1;
+  long before = 0;
+  for (int i = -100; i < 10000; ++i)
+  {
+    if (!i) before = allocations;
+    BT_TRACE(3, "Drew " << count << " shapes in " << ms << "ms for " <<
+      name << ' ' << small << ' ' << big << ' ' << negative << ' ' <<
+      std::hex << 255 << std::dec << ' ' << 1.0f / 3 << std::endl);
+    BT_TRACE_BIN(3, "Drew {} shapes in {}ms for {}", count, ms, name);
+    BT_TRACE(9, "Filtered " << i);
+  }
+  long made = allocations - before;
+  printf("%s: %ld allocations in 30000 calls\n", label, made);
+  return made;
+}
+
+int main()
+{
+  int failures = 0;
+  Engine *engine = Engine::Get();
+  engine->SetHeadless(true);
+  engine->InitializeAll();
+  Trace *trace = engine->GetSystem<Trace>();
+  trace->SetMaxPrintLevel(4);
+  trace->OpenFile("trace_allocations.log");
+
+  if (Run("sync")) ++failures;
+  if (trace->SetAsync(true))
+  {
+    if (Run("async")) ++failures;
+    trace->SetAsync(false);
+  }
+  trace->OpenBinary("trace_allocations.bin");
+  if (Run("binary")) ++failures;
+  trace->CloseBinary();
+
+  // TraceLine matches a std::stringstream with default settings
+  {
+    TraceLine line;
+    std::stringstream expected;
+    line << (const void *)0x1234 << ' ' << true << ' ' <<
+      (unsigned char)'A' << ' ' << -0.0 << ' ' << 1e300 << ' ' <<
+      std::oct << 8 << std::dec << ' ' << (short)-32768;
+    expected << (const void *)0x1234 << ' ' << true << ' ' <<
+      (unsigned char)'A' << ' ' << -0.0 << ' ' << 1e300 << ' ' <<
+      std::oct << 8 << std::dec << ' ' << (short)-32768;
+    if (expected.str() != line.GetText())
+    {
+      printf("TraceLine wrote \"%s\" instead of \"%s\"\n", line.GetText(),
+        expected.str().c_str());
+      ++failures;
+    }
+  }
+
+  // Long lines are cut short instead of overflowing
+  {
+    TraceLine line;
+    line << std::string(MAX_TRACE_LENGTH * 2, 'x') << 5;
+    if (line.GetLength() != MAX_TRACE_LENGTH - 1)
+    {
+      printf("A long line was %u characters\n", unsigned(line.GetLength()));
+      ++failures;
+    }
+  }
+
+  engine->Shutdown();
+  if (!failures) printf("trace_allocations passed\n");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+/******************************************************************************/
+/*!
+\file undeclared_systems.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Checks that systems which never declared their accesses are updated on
+the thread calling Engine::Update, even when there are workers, while
+declared systems may still run on the workers.
+*/
+/******************************************************************************/
+#include "brewtools.h"
+#include <atomic>  // std::atomic
+#include <cstdio>  // printf
+#include <thread>  // std::this_thread
+
+using namespace BrewTools;
+
+//! Thread that called Engine::Update
+static std::thread::id mainthread;
+
+//! Updates of undeclared systems made off the calling thread
+static std::atomic<int> strays(0);
+
+//! Updates made in total
+static std::atomic<int> updates(0);
+
+/*****************************************/
+/*!
+\brief
+System that never declares its accesses.
+*/
+/*****************************************/
+template <int N>
+class Undeclared : public System<Undeclared<N> >
+{
+public:
+  void Update()
+  {
+    if (std::this_thread::get_id() != mainthread) ++strays;
+    ++updates;
+  }
+};
+
+/*****************************************/
+/*!
+\brief
+System that declares it touches nothing, so it can run anywhere.
+*/
+/*****************************************/
+template <int N>
+class Declared : public System<Declared<N> >
+{
+public:
+  Declared() { this->DeclareAccess(); }
+  void Update()
+  {
+    // Long enough that the workers pick up the ready systems
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+    ++updates;
+  }
+};
+
+int main()
+{
+  int failures = 0;
+  mainthread = std::this_thread::get_id();
+  Engine *engine = Engine::Create();
+  engine->SetHeadless(true);
+  engine->SetWorkerCount(4);
+  engine->GetSystem<Declared<0> >();
+  engine->GetSystem<Undeclared<0> >();
+  engine->GetSystem<Declared<1> >();
+  engine->GetSystem<Undeclared<1> >();
+  engine->GetSystem<Declared<2> >();
+  engine->GetSystem<Undeclared<2> >();
+
+  const int frames = 50;
+  for (int frame = 0; frame < frames; ++frame)
+    engine->Update();
+
+  if (strays)
+  {
+    printf("Undeclared systems were updated off the calling thread %d times\n",
+      strays.load());
+    ++failures;
+  }
+  if (updates != frames * 6)
+  {
+    printf("%d of %d updates were made\n", updates.load(), frames * 6);
+    ++failures;
+  }
+
+  engine->Shutdown();
+  if (!failures) printf("undeclared_systems passed\n");
+  return failures ? 1 : 0;
+}
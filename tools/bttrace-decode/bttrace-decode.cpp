@@ -0,0 +1,309 @@
+/******************************************************************************/
+/*!
+\file bttrace-decode.cpp
+\author Bryce Dixon
+\par email: realbthedestroyer\@gmail.com
+\par BrewTools
+\date 12/11/2017
+\par Created: v1.0
+\par Updated: v1.0
+
+\brief
+Turns a binary trace log (see Trace::OpenBinary) back into text.
+Built for the host with "make tools".
+Usage: bttrace-decode <log> [output]
+Each line reads "[level] seconds message", seconds counted from when the
+log was opened. Lines go to the output file if one is given, otherwise
+to stdout.
+*/
+/******************************************************************************/
+#include "brewtools/tracebinary.h" // TraceBinary, TraceArg
+#include <cstdio>   // fprintf
+#include <cstring>  // memcmp
+#include <fstream>  // std::ifstream, std::ofstream
+#include <iomanip>  // std::setprecision
+#include <iostream> // std::cout
+#include <map>      // std::map
+#include <sstream>  // std::stringstream
+#include <string>   // std::string
+
+using namespace BrewTools;
+
+static std::streamoff logsize; //!< Bytes in the log being decoded
+
+/*****************************************/
+/*!
+\brief
+What a format ID stands for.
+*/
+/*****************************************/
+struct Format
+{
+  uint32_t level; //!< Level of the call site
+  std::string signature; //!< Argument types
+  std::string format; //!< Format string
+};
+
+/*****************************************/
+/*!
+\brief
+Reads a value from the log.
+
+\return
+false if the log ended.
+*/
+/*****************************************/
+template <typename T>
+static bool ReadValue(std::ifstream &file, T &value)
+{
+  return bool(file.read((char *)&value, sizeof(T)));
+}
+
+/*****************************************/
+/*!
+\brief
+Reads a string from the log, its length first. A length longer than the
+rest of the log is a broken log, so nothing is allocated for it.
+
+\return
+false if the log ended or the length is broken.
+*/
+/*****************************************/
+static bool ReadString(std::ifstream &file, std::string &text)
+{
+  uint32_t length;
+  if (!ReadValue(file, length)) return false;
+  std::streamoff left = logsize - std::streamoff(file.tellg());
+  if (left < 0 || length > uint64_t(left)) return false;
+  text.resize(length);
+  return !length || file.read(&text[0], length);
+}
+
+/*****************************************/
+/*!
+\brief
+Reads an argument stored as T and prints it.
+
+\return
+false if the log ended.
+*/
+/*****************************************/
+template <typename T>
+static bool PrintValue(std::ifstream &file, std::ostream &out)
+{
+  T value;
+  if (!ReadValue(file, value)) return false;
+  TraceArg<T>::Print(out, value);
+  return true;
+}
+
+/*****************************************/
+/*!
+\brief
+Reads an argument and prints it.
+
+\param code
+Type of the argument, from the signature.
+
+\return
+false if the log ended or the type is unknown.
+*/
+/*****************************************/
+static bool PrintArg(std::ifstream &file, std::ostream &out, char code)
+{
+  switch (code)
+  {
+  case 'b':
+  {
+    uint8_t value;
+    if (!ReadValue(file, value)) return false;
+    TraceArg<bool>::Print(out, value != 0);
+    return true;
+  }
+  case 'c': return PrintValue<char>(file, out);
+  case 'i': return PrintValue<int32_t>(file, out);
+  case 'u': return PrintValue<uint32_t>(file, out);
+  case 'l': return PrintValue<int64_t>(file, out);
+  case 'L': return PrintValue<uint64_t>(file, out);
+  case 'f': return PrintValue<float>(file, out);
+  case 'd': return PrintValue<double>(file, out);
+  case 'p':
+  {
+    uint64_t value;
+    if (!ReadValue(file, value)) return false;
+    out << "0x" << std::hex << value << std::dec;
+    return true;
+  }
+  case 's':
+  {
+    std::string value;
+    if (!ReadString(file, value)) return false;
+    out << value;
+    return true;
+  }
+  default: return false;
+  }
+}
+
+/*****************************************/
+/*!
+\brief
+Reads a message's arguments and prints it, the way Trace does when it
+isn't in binary mode.
+
+\return
+false if the log ended or is broken.
+*/
+/*****************************************/
+static bool PrintMessage(std::ifstream &file, std::ostream &out,
+  const Format &format)
+{
+  const char *text = format.format.c_str();
+  for (auto code : format.signature)
+  {
+    const char *next = strstr(text, "{}");
+    if (!next)
+    {
+      // Arguments without a "{}" are read but not printed
+      std::stringstream dropped;
+      if (!PrintArg(file, dropped, code)) return false;
+      continue;
+    }
+    out.write(text, next - text);
+    if (!PrintArg(file, out, code)) return false;
+    text = next + 2;
+  }
+  out << text;
+  return true;
+}
+
+/*****************************************/
+/*!
+\brief
+Prints the start of a line.
+*/
+/*****************************************/
+static void PrintPrefix(std::ostream &out, uint32_t level, uint64_t time,
+  uint64_t start)
+{
+  double seconds = (time >= start) ? (time - start) / 1000000.0 : 0.0;
+  out << "[" << level << "] " << std::fixed << std::setprecision(6) <<
+    seconds << " ";
+  out.unsetf(std::ios::floatfield);
+  out << std::setprecision(6);
+}
+
+/*****************************************/
+/*!
+\brief
+Decodes a binary trace log.
+
+\return
+0 on success, 1 if the log couldn't be read.
+*/
+/*****************************************/
+int main(int argc, char **argv)
+{
+  if (argc < 2 || argc > 3)
+  {
+    fprintf(stderr, "Usage: %s <log> [output]\n", argv[0]);
+    return 1;
+  }
+  std::ifstream file(argv[1], std::ios::binary);
+  if (!file.is_open())
+  {
+    fprintf(stderr, "Couldn't open %s\n", argv[1]);
+    return 1;
+  }
+  file.seekg(0, std::ios::end);
+  logsize = file.tellg();
+  file.seekg(0);
+  std::ofstream output;
+  if (argc == 3)
+  {
+    output.open(argv[2]);
+    if (!output.is_open())
+    {
+      fprintf(stderr, "Couldn't open %s\n", argv[2]);
+      return 1;
+    }
+  }
+  std::ostream &out = (argc == 3) ? output : std::cout;
+
+  char magic[sizeof(TraceBinary::MAGIC)];
+  uint32_t order;
+  uint64_t opened, start;
+  if (!file.read(magic, sizeof(magic)) ||
+      memcmp(magic, TraceBinary::MAGIC, sizeof(magic)))
+  {
+    fprintf(stderr, "%s isn't a binary trace log\n", argv[1]);
+    return 1;
+  }
+  if (!ReadValue(file, order) || order != TraceBinary::ORDER_MARK)
+  {
+    fprintf(stderr, "%s was written in another byte order\n", argv[1]);
+    return 1;
+  }
+  if (!ReadValue(file, opened) || !ReadValue(file, start))
+  {
+    fprintf(stderr, "%s ends in its header\n", argv[1]);
+    return 1;
+  }
+  out << "Trace opened at " << opened << "ms";
+
+  // IDs are given out per process, so a log can define any of them
+  std::map<uint32_t, Format> formats;
+  uint8_t kind;
+  while (ReadValue(file, kind))
+  {
+    bool read = false;
+    if (kind == TraceBinary::RECORD_FORMAT)
+    {
+      uint32_t id;
+      Format format;
+      if (ReadValue(file, id) && ReadValue(file, format.level) &&
+          ReadString(file, format.signature) &&
+          ReadString(file, format.format))
+      {
+        formats[id] = format;
+        read = true;
+      }
+    }
+    else if (kind == TraceBinary::RECORD_MESSAGE)
+    {
+      uint32_t id;
+      uint64_t time;
+      std::map<uint32_t, Format>::const_iterator format;
+      if (ReadValue(file, id) && ReadValue(file, time) &&
+          (format = formats.find(id)) != formats.end())
+      {
+        out << std::endl;
+        PrintPrefix(out, format->second.level, time, start);
+        read = PrintMessage(file, out, format->second);
+      }
+    }
+    else if (kind == TraceBinary::RECORD_TEXT)
+    {
+      uint32_t level;
+      uint64_t time;
+      std::string text;
+      if (ReadValue(file, level) && ReadValue(file, time) &&
+          ReadString(file, text))
+      {
+        out << std::endl;
+        PrintPrefix(out, level, time, start);
+        out << text;
+        read = true;
+      }
+    }
+    if (!read)
+    {
+      // A log cut short by a crash ends in the middle of a record
+      out << std::endl;
+      fprintf(stderr, "%s is cut short or broken\n", argv[1]);
+      return 1;
+    }
+  }
+  out << std::endl;
+  return 0;
+}